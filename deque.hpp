@@ -2,389 +2,1260 @@
 #define SJTU_DEQUE_HPP
 #include <cmath>
 #include <cstddef>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define SJTU_DEQUE_PMR 1
+#endif
+#endif
+#ifndef SJTU_DEQUE_PMR
+#define SJTU_DEQUE_PMR 0
+#endif
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#define SJTU_DEQUE_SPAN 1
+#endif
+#endif
+#ifndef SJTU_DEQUE_SPAN
+#define SJTU_DEQUE_SPAN 0
+#endif
+#ifndef SJTU_DEQUE_SIMD
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SJTU_DEQUE_SIMD 1
+#else
+#define SJTU_DEQUE_SIMD 0
+#endif
+#endif
+#if SJTU_DEQUE_SIMD
+#include <immintrin.h>
+#endif
 
 #include "exceptions.hpp"
 
 namespace sjtu {
-// initial size for a block
-const size_t DEFAULT_BLOCK_SIZE = 350;
+// Byte budgets of a block. A block of at least BLOCK_BYTES (a page) keeps
+// the per-block overhead small next to the elements, one of at most
+// MAX_BLOCK_BYTES (a huge page) bounds the memory a block of large elements
+// takes. Whatever the budget, a block holds at least MIN_BLOCK_SIZE.
+const size_t BLOCK_BYTES = 4096;
+const size_t MAX_BLOCK_BYTES = size_t(2) << 20;
+const size_t MIN_BLOCK_SIZE = 8;
+// Empty blocks a deque keeps for reuse by default, one for each end, so a
+// queue that pops at one end and pushes at the other stops allocating.
+const int SPARE_BLOCKS = 2;
+
+// smallest power of two that is at least n
+inline size_t round_up_pow2(size_t n) {
+    size_t res = 1;
+    while (res < n) {
+        res <<= 1;
+    }
+    return res;
+}
+
+// largest power of two that is at most n, 1 for n == 0
+constexpr size_t round_down_pow2(size_t n) {
+    return n < 2 ? 1 : 2 * round_down_pow2(n / 2);
+}
+
+// capacity of a block of elem-byte elements fitting in bytes, a power of two
+// of at least MIN_BLOCK_SIZE
+constexpr size_t block_capacity(size_t bytes, size_t elem) {
+    return round_down_pow2(bytes / elem) < MIN_BLOCK_SIZE
+               ? MIN_BLOCK_SIZE
+               : round_down_pow2(bytes / elem);
+}
+
+// smallest power of two whose square is at least n, about sqrt(n)
+inline size_t root_pow2(size_t n) {
+    size_t res = 1;
+    while (res * res < n) {
+        res <<= 1;
+    }
+    return res;
+}
+
+// Block sizing policies, the BlockPolicy parameter of deque. A policy gives
+//   min_capacity(elem), max_capacity(elem)
+//                             the range new blocks are sized in, constexpr,
+//   capacity(elem, total)     the capacity of a new block,
+//   limit(capacity)           the high watermark: the most elements an
+//                             insert in the middle may leave in a block
+//                             before it is split in two,
+//   low(elem, total)          the low watermark: a block erased below it is
+//                             merged with its smaller neighbour,
+//   merged(n, elem, total)    the capacity of a block merged from n,
+// where elem is sizeof(T) and total the size of the deque. Capacities are
+// rounded up to a power of two. The deque asks for low() only when its
+// size crosses a power of two, passing that power as total, and merges
+// only into a block left at most half full, so a merge and a split are
+// always half a block of insertions or erasures apart.
+
+// Blocks of about sqrt(n) elements, kept between BLOCK_BYTES and
+// MAX_BLOCK_BYTES. Blocks below sqrt(n) / 2 are merged into one with room
+// to double, but of at most 2 sqrt(n), so no block grows past O(sqrt(n))
+// and neither does the work of one insert or erase in the middle.
+struct sqrt_blocks {
+    static constexpr size_t min_capacity(size_t elem) {
+        return block_capacity(BLOCK_BYTES, elem);
+    }
+    static constexpr size_t max_capacity(size_t elem) {
+        return block_capacity(MAX_BLOCK_BYTES, elem);
+    }
+    static size_t capacity(size_t elem, size_t total) {
+        size_t res = root_pow2(total);
+        return std::min(max_capacity(elem), std::max(min_capacity(elem), res));
+    }
+    static size_t limit(size_t capacity) { return capacity - 2; }
+    static size_t low(size_t, size_t total) { return root_pow2(total) / 2; }
+    static size_t merged(size_t n, size_t elem, size_t total) {
+        size_t res = std::min(n * 2, 2 * root_pow2(total));
+        return std::min(max_capacity(elem), std::max(min_capacity(elem), res));
+    }
+};
+
+// Blocks of N elements whatever the size of the deque. A block below a
+// quarter is merged once both fit in half a block.
+template <size_t N>
+struct fixed_blocks {
+    static_assert(N >= 4 && (N & (N - 1)) == 0,
+                  "fixed_blocks needs a power of two of at least 4");
+    static constexpr size_t min_capacity(size_t) { return N; }
+    static constexpr size_t max_capacity(size_t) { return N; }
+    static size_t capacity(size_t, size_t) { return N; }
+    static size_t limit(size_t capacity) { return capacity - 2; }
+    static size_t low(size_t, size_t) { return N / 4; }
+    static size_t merged(size_t, size_t, size_t) { return N; }
+};
 
+// Blocks of at most Bytes bytes of elements, see block_capacity. Use 32 KiB
+// to keep a block in L1, a few hundred KiB for L2. A block below a quarter
+// is merged once both fit in half a block.
+template <size_t Bytes>
+struct byte_blocks {
+    static constexpr size_t min_capacity(size_t elem) {
+        return block_capacity(Bytes, elem);
+    }
+    static constexpr size_t max_capacity(size_t elem) {
+        return block_capacity(Bytes, elem);
+    }
+    static size_t capacity(size_t elem, size_t) { return min_capacity(elem); }
+    static size_t limit(size_t capacity) { return capacity - 2; }
+    static size_t low(size_t elem, size_t) { return min_capacity(elem) / 4; }
+    static size_t merged(size_t, size_t elem, size_t) {
+        return min_capacity(elem);
+    }
+};
+
+// allocators whose construct() is plain placement new, so trivially
+// copyable elements may be copied as bytes
+template <class Alloc>
+struct plain_construct : std::false_type {};
+template <class T>
+struct plain_construct<std::allocator<T> > : std::true_type {};
+#if SJTU_DEQUE_PMR
+template <class T>
+struct plain_construct<std::pmr::polymorphic_allocator<T> >
+    : std::true_type {};
+#endif
+
+#if SJTU_DEQUE_SPAN
+// elements lying next to each other in memory
 template <class T>
-class Node {
+using span = std::span<T>;
+#else
+// elements lying next to each other in memory, std::span before C++20
+template <class T>
+class span {
    public:
-    T data;
-    Node *prev;
-    Node *next;
-    Node(const T &val) : data(val), prev(nullptr), next(nullptr) {}
-    Node() : prev(nullptr), next(nullptr) {}
+    span() : ptr(nullptr), len(0) {}
+    span(T *ptr, size_t len) : ptr(ptr), len(len) {}
+    T *data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    T *begin() const { return ptr; }
+    T *end() const { return ptr + len; }
+    T &operator[](size_t i) const { return ptr[i]; }
+
+   private:
+    T *ptr;
+    size_t len;
 };
+#endif
 
 template <class T>
-class double_list {
-   private:
-    Node<T> *head;
-    Node<T> *tail;
+class block {
+   public:
+    // raw storage from the allocator of the deque, only the slots in
+    // [front, rear) hold constructed elements. blocks are made and freed by
+    // block_map::make() and block_map::drop()
+    T *arr;
+    int front;  // reachable
+    int rear;   // unreachable
+    int capacity;  // a power of two, so ring indices wrap with & mask
+    int mask;
+    std::ptrdiff_t slot;  // position of this block in block_map
+    block(T *arr, int cap)
+        : arr(arr), front(0), rear(0), capacity(cap), mask(cap - 1), slot(0) {}
+    // return size of current elements
+    size_t size() const { return (rear - front) & mask; }
+    // calculate dist
+    int dist(int start, int end) const {
+        return (end - start) & mask;
+    }
+    // address of the element in slot idx, nullptr if the slot is empty
+    T *get(int idx) const {
+        if (dist(front, idx) >= dist(front, rear)) {
+            return nullptr;
+        }
+        return arr + idx;
+    }
+};
+
+// What a block_pool did so far, see block_pool::stats().
+struct pool_stats {
+    size_t requests;      // allocate calls
+    size_t reused;        // of them served from a free list
+    size_t cached;        // arrays waiting on the free lists
+    size_t cached_bytes;  // bytes of those arrays
+};
+
+// Bytes one block_pool keeps on its free lists at most, whatever is given
+// back beyond that goes straight to the system.
+const size_t POOL_BYTES = size_t(4) << 20;
 
+// Free lists of arrays of T, one for each power-of-two length, so every
+// deque of T on a thread hands its blocks and block headers to the next
+// deque that needs the same size class instead of to malloc. Block
+// capacities are powers of two, merge() and split() included, so each
+// block falls into a class, as do directory objects and slot arrays of
+// power-of-two length; other lengths (the odd-sized Fenwick trees) pass
+// through to std::allocator. A pool belongs to one thread and takes no
+// locks. Arrays freed on another thread join the pool of that thread.
+template <class T>
+class block_pool {
    public:
-    double_list() {
-        head = nullptr;
-        tail = nullptr;
+    // the pool of the calling thread, nullptr once it is destroyed at exit
+    static block_pool *local() {
+        if (gone) {
+            return nullptr;
+        }
+        static thread_local block_pool pool;
+        return &pool;
     }
-    double_list(const double_list<T> &other) : head(nullptr), tail(nullptr) {
-        Node<T> *tmp = other.head;
-        while (tmp) {
-            insert_tail(tmp->data);
-            tmp = tmp->next;
+    block_pool() : stat() {
+        for (int c = 0; c < CLASSES; c++) {
+            lists[c] = nullptr;
         }
     }
-    ~double_list() {
-        // std::cout << "destructing double_list!" << std::endl;
-        clear();
+    block_pool(const block_pool &) = delete;
+    block_pool &operator=(const block_pool &) = delete;
+    ~block_pool() {
+        trim();
+        gone = true;
     }
-    class iterator {
-       public:
-        Node<T> *cur;
-        iterator() { cur = nullptr; }
-        iterator(const iterator &other) { cur = other.cur; }
-        iterator(Node<T> *ptr) : cur(ptr){};
-        ~iterator() {}
-        // iter++
-        iterator operator++(int) {
-            iterator tmp = *this;
-            if (cur == nullptr) {
-                throw "invalid";
+    T *allocate(size_t n) {
+        stat.requests++;
+        int c = size_class(n);
+        if (c < 0 || lists[c] == nullptr) {
+            return std::allocator<T>().allocate(n);
+        }
+        node *p = lists[c];
+        lists[c] = p->next;
+        stat.reused++;
+        stat.cached--;
+        stat.cached_bytes -= n * sizeof(T);
+        return reinterpret_cast<T *>(p);
+    }
+    void deallocate(T *p, size_t n) {
+        int c = size_class(n);
+        if (c < 0 || stat.cached_bytes + n * sizeof(T) > POOL_BYTES) {
+            std::allocator<T>().deallocate(p, n);
+            return;
+        }
+        lists[c] = new (static_cast<void *>(p)) node{lists[c]};
+        stat.cached++;
+        stat.cached_bytes += n * sizeof(T);
+    }
+    // give every array on the free lists back, return the bytes freed
+    size_t trim() {
+        size_t freed = stat.cached_bytes;
+        for (int c = 0; c < CLASSES; c++) {
+            while (lists[c] != nullptr) {
+                node *p = lists[c];
+                lists[c] = p->next;
+                std::allocator<T>().deallocate(reinterpret_cast<T *>(p),
+                                               size_t(1) << c);
             }
-            cur = cur->next;
-            return tmp;
         }
+        stat.cached = 0;
+        stat.cached_bytes = 0;
+        return freed;
+    }
+    pool_stats stats() const { return stat; }
 
-        // ++iter
-        iterator &operator++() {
-            if (cur == nullptr) {
-                throw "invalid";
-            }
-            cur = cur->next;
-            return *this;
-        }
+   private:
+    // a free array, linked through its first bytes
+    struct node {
+        node *next;
+    };
+    static const int CLASSES = 8 * sizeof(size_t);
+    static thread_local bool gone;
+    // free list of arrays of n, -1 if n is no power of two or the array
+    // cannot hold a node
+    static int size_class(size_t n) {
+        if (n == 0 || (n & (n - 1)) != 0 || n * sizeof(T) < sizeof(node)) {
+            return -1;
+        }
+        int c = 0;
+        while (n >>= 1) {
+            c++;
+        }
+        return c;
+    }
+    node *lists[CLASSES];
+    pool_stats stat;
+};
+template <class T>
+thread_local bool block_pool<T>::gone = false;
 
-        // iter--
-        iterator operator--(int) {
-            iterator tmp = *this;
-            if (cur->prev == nullptr) {
-                throw "invalid";
-            }
-            cur = cur->prev;
-            return tmp;
+template <class T, class Alloc>
+class block_map;
+
+// Stateless allocator drawing from the block_pool of the calling thread,
+// see pooled::deque. Every instance compares equal, so blocks move between
+// pooled deques without copying.
+template <class T>
+struct pool_allocator {
+    typedef T value_type;
+    pool_allocator() {}
+    template <class U>
+    pool_allocator(const pool_allocator<U> &) {}
+    T *allocate(size_t n) {
+        block_pool<T> *pool = block_pool<T>::local();
+        return pool ? pool->allocate(n) : std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, size_t n) {
+        block_pool<T> *pool = block_pool<T>::local();
+        if (pool) {
+            pool->deallocate(p, n);
+        } else {
+            std::allocator<T>().deallocate(p, n);
         }
+    }
+    // what the pools of the calling thread behind deques of T did so far:
+    // element arrays, block headers, directory objects and slot arrays.
+    // the Fenwick trees are never pooled
+    static pool_stats stats() {
+        pool_stats res = pool_stats();
+        add(res, stats_of<T>());
+        add(res, stats_of<block<T> >());
+        add(res, stats_of<block_map<T, pool_allocator> >());
+        add(res, stats_of<block<T> *>());
+        return res;
+    }
+    // free what those pools keep, return the bytes freed
+    static size_t trim() {
+        return trim_of<T>() + trim_of<block<T> >() +
+               trim_of<block_map<T, pool_allocator> >() +
+               trim_of<block<T> *>();
+    }
 
-        //--iter
-        iterator &operator--() {
-            if (cur->prev == nullptr) {
-                throw "invalid";
+   private:
+    template <class U>
+    static pool_stats stats_of() {
+        block_pool<U> *pool = block_pool<U>::local();
+        return pool ? pool->stats() : pool_stats();
+    }
+    template <class U>
+    static size_t trim_of() {
+        block_pool<U> *pool = block_pool<U>::local();
+        return pool ? pool->trim() : 0;
+    }
+    static void add(pool_stats &to, const pool_stats &s) {
+        to.requests += s.requests;
+        to.reused += s.reused;
+        to.cached += s.cached;
+        to.cached_bytes += s.cached_bytes;
+    }
+};
+template <class T, class U>
+bool operator==(const pool_allocator<T> &, const pool_allocator<U> &) {
+    return true;
+}
+template <class T, class U>
+bool operator!=(const pool_allocator<T> &, const pool_allocator<U> &) {
+    return false;
+}
+template <class T>
+struct plain_construct<pool_allocator<T> > : std::true_type {};
+
+// Contiguous directory of blocks, like the map of std::deque. Blocks sit in
+// slots [first, last) of one array with free slots on both sides, so the
+// neighbour of a block is one array step away, a block added next to either
+// end costs O(1) and one added or dropped in the middle only memmoves the
+// shorter side. A Fenwick tree over the block sizes, indexed by slot, finds
+// the block holding a given position in O(log #blocks); element
+// insert/erase keeps it up to date with grow(). Changes to the head and tail
+// blocks only bump headlag/taillag, so pushes and pops at either end skip the
+// tree; settle() folds them in before the set of blocks changes. This also
+// keeps every entry of the tree non-negative, which locate() relies on.
+// Slot numbers are not array indices: slot s is slots[s - lo]. When the
+// array runs short of room at an end, or is mostly empty, the blocks move
+// to a new one, and since no block changes its slot number the move can be
+// spread over the blocks added and dropped at the ends after it starts, a
+// few slots and tree entries at a time; see pace().
+// Every block, element, slot array and tree comes from alloc.
+template <class T, class Alloc = std::allocator<T> >
+class block_map {
+    typedef std::allocator_traits<Alloc> traits;
+    typedef typename traits::template rebind_alloc<block<T> > block_alloc;
+    typedef typename traits::template rebind_alloc<block<T> *> slot_alloc;
+    typedef typename traits::template rebind_alloc<int> tree_alloc;
+    typedef std::allocator_traits<block_alloc> block_traits;
+    typedef std::allocator_traits<slot_alloc> slot_traits;
+    typedef std::allocator_traits<tree_alloc> tree_traits;
+
+   public:
+    block<T> **slots;  // slot s is slots[s - lo]
+    int *tree;  // 1-based Fenwick tree, slot s at s - lo + 1; unused are 0
+    std::ptrdiff_t lo;
+    std::ptrdiff_t first;
+    std::ptrdiff_t last;
+    int cap;
+    int headlag;  // size of the head block not yet recorded in tree
+    int taillag;  // size of the tail block not yet recorded in tree
+    // the arrays the blocks are moving to, slot s at dest[s - destlo]; the
+    // first built entries of desttree are done, see move_on()
+    block<T> **dest;
+    int *desttree;
+    std::ptrdiff_t destlo;
+    int destcap;
+    int built;
+    // the arrays given up by the last move, for a move to the same length
+    block<T> **idle;
+    int *idletree;
+    int idlecap;
+    block<T> **spare;  // empty blocks kept for reuse, see reserve()
+    int spares;        // number of blocks in spare
+    int sparecap;      // length of spare
+    int reserved[2];   // blocks set aside for the front [0] and back [1]
+    int depth;         // blocks kept in spare besides the reserved ones
+    Alloc alloc;
+    explicit block_map(const Alloc &alloc = Alloc())
+        : slots(nullptr),
+          tree(nullptr),
+          lo(0),
+          first(0),
+          last(0),
+          cap(0),
+          headlag(0),
+          taillag(0),
+          dest(nullptr),
+          desttree(nullptr),
+          destlo(0),
+          destcap(0),
+          built(0),
+          idle(nullptr),
+          idletree(nullptr),
+          idlecap(0),
+          spare(nullptr),
+          spares(0),
+          sparecap(0),
+          reserved{0, 0},
+          depth(SPARE_BLOCKS),
+          alloc(alloc) {
+        relayout();
+    }
+    // copy the blocks of other, allocating from alloc
+    block_map(const block_map &other, const Alloc &alloc)
+        : block_map(alloc) {
+        depth = other.depth;
+        for (std::ptrdiff_t s = other.first; s < other.last; ++s) {
+            block<T> *b = clone(other.at(s));
+            try {
+                push_back(b);
+            } catch (...) {
+                drop(b);
+                throw;
             }
-            cur = cur->prev;
-            return *this;
         }
-        /**
-         * if the iter didn't point to a value
-         * throw " invalid"
-         */
-        T &operator*() const {
-            if (cur) {
-                return cur->data;
-            } else {
-                throw "invalid";
-            }
+    }
+    ~block_map() {
+        for (std::ptrdiff_t s = first; s < last; ++s) {
+            drop(at(s));
         }
-
-        // other operation
-        T *operator->() const noexcept { return &cur->data; }
-        bool operator==(const iterator &rhs) const {
-            if (cur == rhs.cur) {
-                return true;
-            } else {
-                return false;
+        unreserve();
+        free_arrays();
+    }
+    // a new empty block with room for cap elements, rounded up to a power
+    // of two
+    block<T> *make(size_t cap) {
+        int capacity = round_up_pow2(cap);
+        block_alloc balloc(alloc);
+        block<T> *b = block_traits::allocate(balloc, 1);
+        try {
+            new (b) block<T>(traits::allocate(alloc, capacity), capacity);
+        } catch (...) {
+            block_traits::deallocate(balloc, b, 1);
+            throw;
+        }
+        return b;
+    }
+    // destroy the elements of b and free it
+    void drop(block<T> *b) {
+        if (b == nullptr) {
+            return;
+        }
+        destroy(b, b->front, b->rear);
+        traits::deallocate(alloc, b->arr, b->capacity);
+        block_alloc balloc(alloc);
+        block_traits::deallocate(balloc, b, 1);
+    }
+    // a block holding copies of the elements of b, in the same slots
+    block<T> *clone(const block<T> *b) {
+        block<T> *res = make(b->capacity);
+        res->front = res->rear = b->front;
+        try {
+            for (int i = b->front; i != b->rear; i = (i + 1) & b->mask) {
+                construct(res->arr + i, b->arr[i]);
+                res->rear = (i + 1) & b->mask;
             }
+        } catch (...) {
+            drop(res);
+            throw;
         }
-        bool operator!=(const iterator &rhs) const {
-            if (cur != rhs.cur) {
-                return true;
-            } else {
-                return false;
-            }
+        return res;
+    }
+    // elements are built and destroyed through the allocator
+    template <class... Args>
+    void construct(T *p, Args &&...args) {
+        traits::construct(alloc, p, std::forward<Args>(args)...);
+    }
+    void destroy(T *p) { traits::destroy(alloc, p); }
+    // destroy the elements of b in slots [from, to)
+    void destroy(block<T> *b, int from, int to) {
+        for (int i = from; i != to; i = (i + 1) & b->mask) {
+            destroy(b->arr + i);
         }
-    };
-    class const_iterator {
-       public:
-        const Node<T> *cur;
-        const_iterator() : cur(nullptr) {}
-        const_iterator(const Node<T> *ptr) : cur(ptr) {}
-        const_iterator(const const_iterator &other) : cur(other.cur) {}
-        const_iterator operator--(int) {
-            const_iterator tmp = *this;
-            if (cur->prev == nullptr) {
-                throw "invalid";
-            }
-            cur = cur->prev;
-            return tmp;
+    }
+    // elements that may be moved as bytes: trivially copyable ones, built
+    // by plain placement new
+    typedef std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+                                             plain_construct<Alloc>::value>
+        bytewise;
+    // Move the k elements of from starting at slot src into the empty
+    // slots of to starting at dst; the slots they leave are empty
+    void transfer(block<T> *to, int dst, block<T> *from, int src, int k) {
+        transfer(to, dst, from, src, k, bytewise());
+    }
+    // Move the k elements of b starting at slot src by d slots, towards the
+    // rear when d > 0. the slots moved into must be empty or among the k;
+    // the slots left behind are empty
+    void shift(block<T> *b, int src, int k, int d) {
+        shift(b, src, k, d, bytewise());
+    }
+    // one memcpy per stretch where neither ring wraps
+    void transfer(block<T> *to, int dst, block<T> *from, int src, int k,
+                  std::true_type) {
+        while (k > 0) {
+            int run = std::min(k, std::min(from->capacity - src,
+                                           to->capacity - dst));
+            std::memcpy(to->arr + dst, from->arr + src, run * sizeof(T));
+            src = (src + run) & from->mask;
+            dst = (dst + run) & to->mask;
+            k -= run;
         }
-
-        //--iter
-        const_iterator &operator--() {
-            if (cur->prev == nullptr) {
-                throw "invalid";
-            }
-            cur = cur->prev;
-            return *this;
+    }
+    void transfer(block<T> *to, int dst, block<T> *from, int src, int k,
+                  std::false_type) {
+        for (int i = 0; i < k; ++i) {
+            T &x = from->arr[(src + i) & from->mask];
+            construct(to->arr + ((dst + i) & to->mask), std::move(x));
+            destroy(&x);
         }
-        const_iterator operator++(int) {
-            if (cur == nullptr) {
-                throw "invalid";
+    }
+    // one memmove per stretch where neither the elements nor their new
+    // slots wrap; the stretch moved first is the one whose slots are
+    // overwritten last
+    void shift(block<T> *b, int src, int k, int d, std::true_type) {
+        if (d > 0) {
+            while (k > 0) {
+                int s = (src + k - 1) & b->mask;  // the last one left
+                int t = (s + d) & b->mask;
+                int run = std::min(k, std::min(s, t) + 1);
+                std::memmove(b->arr + t - run + 1, b->arr + s - run + 1,
+                             run * sizeof(T));
+                k -= run;
             }
-            const_iterator tmp(*this);
-            cur = cur->next;
-            return tmp;
+            return;
         }
-        const_iterator &operator++() {
-            if (cur == nullptr) {
-                throw "invalid";
-            }
-            cur = cur->next;
-            return *this;
+        int dst = (src + d) & b->mask;
+        while (k > 0) {
+            int run = std::min(k, std::min(b->capacity - src,
+                                           b->capacity - dst));
+            std::memmove(b->arr + dst, b->arr + src, run * sizeof(T));
+            src = (src + run) & b->mask;
+            dst = (dst + run) & b->mask;
+            k -= run;
         }
-        const T &operator*() const {
-            if (!cur) {
-                // std::cout << "const T &operator*() const" << std::endl;
-                throw "invalid";
+    }
+    void shift(block<T> *b, int src, int k, int d, std::false_type) {
+        int m = b->mask;
+        if (d > 0) {
+            for (int i = k - 1; i >= 0; --i) {
+                T &x = b->arr[(src + i) & m];
+                T *to = b->arr + ((src + i + d) & m);
+                if (i + d >= k) {
+                    construct(to, std::move(x));
+                } else {
+                    *to = std::move(x);
+                }
+            }
+            destroy(b, src, (src + std::min(d, k)) & m);
+            return;
+        }
+        d = -d;
+        for (int i = 0; i < k; ++i) {
+            T &x = b->arr[(src + i) & m];
+            T *to = b->arr + ((src + i - d) & m);
+            if (i < d) {
+                construct(to, std::move(x));
+            } else {
+                *to = std::move(x);
             }
-            return cur->data;
         }
-        const T *operator->() const noexcept { return &cur->data; }
+        destroy(b, (src + std::max(k - d, 0)) & m, (src + k) & m);
+    }
 
-        bool operator==(const const_iterator &rhs) const {
-            return cur == rhs.cur;
+    // an array of n block pointers
+    block<T> **make_slots(int n) {
+        slot_alloc salloc(alloc);
+        return slot_traits::allocate(salloc, n);
+    }
+    void free_slots(block<T> **p, int n) {
+        slot_alloc salloc(alloc);
+        slot_traits::deallocate(salloc, p, n);
+    }
+    int count() const { return int(last - first); }
+    block<T> *&at(std::ptrdiff_t s) { return slots[s - lo]; }
+    block<T> *at(std::ptrdiff_t s) const { return slots[s - lo]; }
+    // slot s in the array, for runs of slots
+    block<T> **where(std::ptrdiff_t s) const { return slots + (s - lo); }
+    block<T> *head() const { return at(first); }
+    block<T> *tail() const { return at(last - 1); }
+    // neighbours of a block, nullptr past either end
+    block<T> *prev(const block<T> *b) const {
+        return b->slot > first ? at(b->slot - 1) : nullptr;
+    }
+    block<T> *next(const block<T> *b) const {
+        return b->slot + 1 < last ? at(b->slot + 1) : nullptr;
+    }
+    // free slots left at the fuller end of the array
+    int room() const { return int(std::min(first - lo, lo + cap - last)); }
+    // length of an array with room on both sides for at least extra more
+    // blocks, and for the spare ones
+    int fitting(int extra) const {
+        return 2 * (count() + std::max(extra, spares)) + 8;
+    }
+    // move the blocks to the middle of a fresh array with room on both
+    // sides for at least extra more blocks, all at once
+    void relayout(int extra = 0) {
+        move_to(fitting(extra));
+        finish();
+    }
+    bool moving() const { return dest != nullptr; }
+    // Start moving the blocks to the middle of arrays of n slots, which
+    // move_on() fills in. The arrays given up by the last move are reused
+    // if they are that long, so a queue drifting along its directory
+    // allocates nothing.
+    void move_to(int n) {
+        finish();
+        stock(n);
+        dest = idle;
+        desttree = idletree;
+        idle = nullptr;
+        idletree = nullptr;
+        destcap = n;
+        destlo = first - (n - count()) / 2;
+        built = 0;
+    }
+    // Fill in the next n slots and tree entries of the arrays being moved
+    // to, and switch to them once all are. An entry of the Fenwick tree is
+    // its own slot plus the entries below it it covers, which are done by
+    // then; add() keeps the done ones up to date. Must be called settled
+    void move_on(int n) {
+        for (; n > 0 && built < destcap; --n) {
+            int j = ++built;
+            std::ptrdiff_t s = destlo + j - 1;
+            int size = 0;
+            if (s >= first && s < last) {
+                dest[j - 1] = at(s);
+                size = sum(s + 1) - sum(s);
+            }
+            for (int k = 1; k < (j & -j); k <<= 1) {
+                size += desttree[j - k];
+            }
+            desttree[j] = size;
+        }
+        if (built < destcap) {
+            return;
+        }
+        free_idle();
+        if (cap == destcap) {
+            idle = slots;
+            idletree = tree;
+            idlecap = cap;
+        } else if (slots != nullptr) {
+            tree_alloc talloc(alloc);
+            free_slots(slots, cap);
+            tree_traits::deallocate(talloc, tree, cap + 1);
+        }
+        slots = dest;
+        tree = desttree;
+        lo = destlo;
+        cap = destcap;
+        dest = nullptr;
+        desttree = nullptr;
+    }
+    // make the idle arrays n slots long
+    void stock(int n) {
+        if (idle != nullptr && idlecap == n) {
+            return;
+        }
+        free_idle();
+        tree_alloc talloc(alloc);
+        block<T> **ns = make_slots(n);
+        try {
+            idletree = tree_traits::allocate(talloc, n + 1);
+        } catch (...) {
+            free_slots(ns, n);
+            throw;
+        }
+        idle = ns;
+        idlecap = n;
+    }
+    void finish() {
+        if (moving()) {
+            move_on(destcap);
         }
-        bool operator!=(const const_iterator &rhs) const {
-            return cur != rhs.cur;
+    }
+    // Keep a move going before a block is added at or dropped from an end:
+    // enough steps that it is done before the old array runs out of room at
+    // either end, and at least four, so that the new one, whose ends start
+    // at least a quarter empty, does not either. Start one once the room
+    // left at an end is down to an eighth of the array. Must be called
+    // settled
+    void pace() {
+        if (!moving() && room() <= cap / 8) {
+            int n = fitting(1);
+            move_to(n <= cap ? cap : n);
+        }
+        if (moving()) {
+            int r = room();
+            int left = destcap - built;
+            move_on(r == 0 ? left : std::max(4, (left + r - 1) / r));
         }
-    };
-    const_iterator begin() const { return const_iterator(head); }
-    const_iterator end() const { return const_iterator(nullptr); }
-
-    iterator begin() { return iterator(head); }
-
-    iterator end() { return iterator(nullptr); }
-
-    iterator insert(iterator pos, const T &val) {
-        Node<T> *newNode = new Node<T>;
-        newNode->data = val;
-        // delete val;
-        if (pos.cur == nullptr) {
-            return pos;
+    }
+    // record the pending head/tail sizes in tree
+    void settle() {
+        if (headlag != 0) {
+            add(first, headlag);
+            headlag = 0;
         }
-        Node<T> *tmp = pos.cur;
-        if (tmp->prev) {
-            tmp->prev->next = newNode;
-            newNode->prev = tmp->prev;
+        if (taillag != 0) {
+            add(last - 1, taillag);
+            taillag = 0;
         }
-        newNode->next = tmp;
-        tmp->prev = newNode;
-        if (tmp == head) {
-            head = newNode;
+    }
+    // the block in slot s gained (or lost) delta elements
+    void grow(std::ptrdiff_t s, int delta) {
+        if (s == first) {
+            headlag += delta;
+        } else if (s == last - 1) {
+            taillag += delta;
+        } else {
+            add(s, delta);
         }
-        iterator newIter(newNode);
-        // delete val;
-        return newIter;
     }
-    iterator erase(iterator pos) {
-        if (pos.cur == nullptr) {
-            return pos;
+    // add delta to the size recorded in tree for slot s, and in the done
+    // entries of the tree being moved to
+    void add(std::ptrdiff_t s, int delta) {
+        for (int j = int(s - lo) + 1; j <= cap; j += j & -j) {
+            tree[j] += delta;
+        }
+        if (moving()) {
+            for (int j = int(s - destlo) + 1; j <= built; j += j & -j) {
+                desttree[j] += delta;
+            }
+        }
+    }
+    // number of elements recorded in tree for the slots before s
+    int sum(std::ptrdiff_t s) const {
+        int res = 0;
+        for (int j = int(std::min<std::ptrdiff_t>(s - lo, cap)); j > 0;
+             j -= j & -j) {
+            res += tree[j];
+        }
+        return res;
+    }
+    // number of elements stored in the slots before s
+    int prefix(std::ptrdiff_t s) const {
+        int res = sum(s);
+        if (s > first) {
+            res += headlag;
         }
-        Node<T> *tmp = pos.cur;
-        if (tmp->prev && tmp->next) {
-            tmp->prev->next = tmp->next;
-            tmp->next->prev = tmp->prev;
+        if (s >= last) {
+            res += taillag;
         }
-        if (tmp->next && !tmp->prev) {
-            tmp->next->prev = nullptr;
+        return res;
+    }
+    int total() const { return sum(last) + headlag + taillag; }
+    // return the slot of the block holding position pos, which must be
+    // less than total(); pos is left as the offset inside that block
+    std::ptrdiff_t locate(int &pos) const {
+        if (pos < int(head()->size())) {
+            return first;
+        }
+        pos -= headlag;
+        int j = 0;
+        int step = 1;
+        while (step * 2 <= cap) {
+            step *= 2;
+        }
+        for (; step > 0; step /= 2) {
+            if (j + step <= cap && tree[j + step] <= pos) {
+                j += step;
+                pos -= tree[j];
+            }
         }
-        if (tmp->prev && !tmp->next) {
-            tmp->prev->next = nullptr;
+        std::ptrdiff_t s = lo + j;
+        if (s >= last - 1) {
+            // the tree may not know all of the tail yet
+            pos += sum(s) - sum(last - 1);
+            s = last - 1;
         }
-        if (tmp == head) {
-            head = tmp->next;
+        return s;
+    }
+    // insert b right before the block in slot s (s == last appends)
+    void insert(std::ptrdiff_t s, block<T> *b) { insert(s, &b, 1); }
+    // insert the k blocks bs right before the block in slot s, opening the
+    // gap once. a block added at an end moves a move along, anything else
+    // finishes it first
+    void insert(std::ptrdiff_t s, block<T> *const *bs, int k) {
+        settle();
+        if (k == 1 && (s == first || s == last)) {
+            pace();
+            std::ptrdiff_t t = s == first ? first - 1 : last;
+            if (moving() && (t < destlo || t >= destlo + destcap)) {
+                finish();
+            }
+        } else {
+            finish();
+        }
+        if (first - lo < k || lo + cap - last < k) {
+            // only reallocate an array that is at least half full
+            int n = fitting(k);
+            move_to(n <= cap ? cap : n);
+            finish();
+        }
+        int moved = int(std::min(s - first, last - s)) + k;
+        bool whole = !moving() && rebuild_cheaper(moved);
+        if (s - first < last - s) {
+            std::memmove(where(first) - k, where(first),
+                         (s - first) * sizeof(block<T> *));
+            first -= k;
+            s -= k;
+            for (std::ptrdiff_t j = first; j < s && !whole; ++j) {
+                shifted(j, j + k);
+            }
+        } else {
+            std::memmove(where(s) + k, where(s),
+                         (last - s) * sizeof(block<T> *));
+            last += k;
+            for (std::ptrdiff_t j = s + k; j < last && !whole; ++j) {
+                shifted(j, j - k);
+            }
         }
-        if (tmp == tail) {
-            tail = tmp->prev;
+        for (int i = 0; i < k; ++i) {
+            at(s + i) = bs[i];
+            bs[i]->slot = s + i;
+            if (moving() && s + i - destlo < built) {
+                dest[s + i - destlo] = bs[i];
+            }
+            if (!whole) {
+                add(s + i, bs[i]->size());
+            }
         }
-        iterator newIter(tmp->prev);
-        if (tmp->data) {
-            delete tmp->data;
-            tmp->data = nullptr;
+        if (whole) {
+            rebuild();
         }
-        delete tmp;
-        tmp = nullptr;
-        return newIter;
     }
-    iterator get_tail() const { return iterator(tail); }
-    iterator get_tail() { return iterator(tail); }
-    iterator get_head() const { return iterator(head); }
-
-    void insert_head(const T &val) {
-        Node<T> *newNode = new Node<T>(val);
-        if (head == nullptr) {
-            head = newNode;
-            tail = newNode;
+    void push_back(block<T> *b) { insert(last, b); }
+    void push_front(block<T> *b) { insert(first, b); }
+    // delete the block in slot s, closing the gap from the shorter side
+    void erase(std::ptrdiff_t s) { erase(s, 1); }
+    // delete the k blocks in slots [s, s + k), closing the gap once
+    void erase(std::ptrdiff_t s, int k) {
+        for (std::ptrdiff_t j = s; j < s + k; ++j) {
+            retire(at(j));
+        }
+        release(s, k);
+    }
+    // take the k blocks in slots [s, s + k) out without deleting them. a
+    // block taken from an end moves a move along, anything else finishes it
+    // first
+    void release(std::ptrdiff_t s, int k) {
+        if (k == 0) {
+            return;
+        }
+        settle();
+        if (k == 1 && (s == first || s == last - 1)) {
+            pace();
         } else {
-            newNode->next = head;
-            head->prev = newNode;
-            head = newNode;
+            finish();
+        }
+        int moved = int(std::min(s - first, last - s - k)) + k;
+        bool whole = !moving() && rebuild_cheaper(moved);
+        for (std::ptrdiff_t j = s; j < s + k && !whole; ++j) {
+            add(j, sum(j) - sum(j + 1));
+        }
+        if (s - first < last - s - k) {
+            std::memmove(where(first) + k, where(first),
+                         (s - first) * sizeof(block<T> *));
+            first += k;
+            for (std::ptrdiff_t j = first; j < s + k && !whole; ++j) {
+                shifted(j, j - k);
+            }
+        } else {
+            std::memmove(where(s), where(s) + k,
+                         (last - s - k) * sizeof(block<T> *));
+            last -= k;
+            for (std::ptrdiff_t j = s; j < last && !whole; ++j) {
+                shifted(j, j + k);
+            }
+        }
+        if (whole) {
+            rebuild();
+        }
+        // move to a smaller array once this one is emptied to an eighth,
+        // unless space was reserved; should that fail, the old one still
+        // works
+        if (!moving() && cap > 64 && count() * 8 < cap && !reserving()) {
+            try {
+                move_to(fitting(0));
+            } catch (...) {
+            }
         }
     }
-    void insert_tail(const T &val) {
-        Node<T> *newNode = new Node<T>(val);
-        if (tail == nullptr) {
-            head = tail = newNode;
+    // put b into slot s in place of the block there, which is not deleted
+    void replace(std::ptrdiff_t s, block<T> *b) {
+        settle();
+        finish();
+        add(s, int(b->size()) - (sum(s + 1) - sum(s)));
+        at(s) = b;
+        b->slot = s;
+    }
+    // delete every block, keeping what was reserved
+    void clear() {
+        settle();
+        finish();
+        for (std::ptrdiff_t s = first; s < last; ++s) {
+            retire(at(s));
+        }
+        first = last = lo + cap / 2;
+        if (reserving()) {
+            rebuild();
         } else {
-            tail->next = newNode;
-            newNode->prev = tail;
-            tail = newNode;
+            relayout();
         }
     }
-    void delete_head() {
-        if (!head) return;
-        Node<T> *tmp = head;
-        head = head->next;
-        if (head) head->prev = nullptr;
-        delete tmp;
+    // An empty block kept for reuse, or nullptr. Blocks the deque no longer
+    // needs are kept, up to the number reserve() set aside and depth more,
+    // so pushes and pops that stay within a reservation, or a queue that
+    // pops about as fast as it pushes, never allocate nor free.
+    block<T> *take_spare() { return spares > 0 ? spare[--spares] : nullptr; }
+    int keep() const { return reserved[0] + reserved[1] + depth; }
+    bool reserving() const { return reserved[0] + reserved[1] > 0; }
+    // destroy the elements of b and keep it for reuse if there is room,
+    // free it otherwise
+    void retire(block<T> *b) {
+        if (b == nullptr || spares >= keep()) {
+            drop(b);
+            return;
+        }
+        if (sparecap < keep()) {
+            try {
+                grow_spare(keep());
+            } catch (...) {
+                drop(b);
+                return;
+            }
+        }
+        destroy(b, b->front, b->rear);
+        b->front = b->rear = 0;
+        spare[spares++] = b;
+    }
+    // set aside k empty blocks of at least size elements for pushes at end
+    // e (0 the front, 1 the back), and room for them in the directory
+    void reserve(int e, int k, size_t size) {
+        reserved[e] = k;
+        int want = reserved[0] + reserved[1];
+        grow_spare(keep());
+        // blocks kept from before may be too small, or too many
+        int kept = 0;
+        for (int i = 0; i < spares; ++i) {
+            if (spare[i]->capacity >= int(size) && kept < keep()) {
+                spare[kept++] = spare[i];
+            } else {
+                drop(spare[i]);
+            }
+        }
+        spares = kept;
+        while (spares < want) {
+            spare[spares] = make(size);
+            ++spares;
+        }
+        settle();
+        if (2 * (count() + want) + 8 > cap) {
+            relayout(want);
+        }
+        // and the arrays the next move of the blocks goes to
+        finish();
+        stock(cap);
     }
-    void delete_tail() {
-        if (!tail) return;
-        Node<T> *tmp = tail;
-        tail = tail->prev;
-        if (tail) tail->next = nullptr;
-        delete tmp;
+    // keep up to n blocks in spare besides the reserved ones
+    void cache(int n) {
+        depth = n;
+        while (spares > keep()) {
+            drop(spare[--spares]);
+        }
+    }
+    // make room in spare for n blocks
+    void grow_spare(int n) {
+        if (n <= sparecap) {
+            return;
+        }
+        block<T> **grown = make_slots(n);
+        for (int i = 0; i < spares; ++i) {
+            grown[i] = spare[i];
+        }
+        if (spare != nullptr) {
+            free_slots(spare, sparecap);
+        }
+        spare = grown;
+        sparecap = n;
+    }
+    // free the spare blocks and idle arrays, and forget the reservations
+    void unreserve() {
+        for (int i = 0; i < spares; ++i) {
+            drop(spare[i]);
+        }
+        if (spare != nullptr) {
+            free_slots(spare, sparecap);
+        }
+        spare = nullptr;
+        spares = sparecap = 0;
+        reserved[0] = reserved[1] = 0;
+        free_idle();
     }
 
-    bool empty() {
-        if (head == nullptr) {
-            return true;
-        } else {
-            return false;
+   private:
+    // whether rebuilding tree, O(cap), beats updating it for n moved slots,
+    // two O(log cap) updates each; this keeps a directory update linear
+    bool rebuild_cheaper(int n) const {
+        int lg = 1;
+        while ((1 << lg) < cap) {
+            ++lg;
+        }
+        return 2 * n * lg > cap;
+    }
+    // rebuild tree from the blocks in slots [first, last)
+    void rebuild() {
+        for (int j = 0; j <= cap; ++j) {
+            tree[j] = 0;
+        }
+        for (std::ptrdiff_t s = first; s < last; ++s) {
+            at(s)->slot = s;
+            tree[s - lo + 1] = at(s)->size();
+        }
+        for (int j = 1; j <= cap; ++j) {
+            int parent = j + (j & -j);
+            if (parent <= cap) {
+                tree[parent] += tree[j];
+            }
         }
+        headlag = taillag = 0;
     }
-    bool empty() const {
-        if (head == nullptr) {
-            return true;
-        } else {
-            return false;
+    void free_idle() {
+        if (idle != nullptr) {
+            tree_alloc talloc(alloc);
+            free_slots(idle, idlecap);
+            tree_traits::deallocate(talloc, idletree, idlecap + 1);
+            idle = nullptr;
+            idletree = nullptr;
         }
     }
-    void clear() {
-        Node<T> *tmp = head;
-        while (tmp) {
-            Node<T> *next = tmp->next;
-            delete tmp->data;
-            delete tmp;
-            tmp = next;
+    void free_arrays() {
+        tree_alloc talloc(alloc);
+        if (slots != nullptr) {
+            free_slots(slots, cap);
+            tree_traits::deallocate(talloc, tree, cap + 1);
         }
-        head = tail = nullptr;
+        if (dest != nullptr) {
+            free_slots(dest, destcap);
+            tree_traits::deallocate(talloc, desttree, destcap + 1);
+        }
+        free_idle();
+    }
+    // the block now in slot to used to be in slot from
+    void shifted(std::ptrdiff_t to, std::ptrdiff_t from) {
+        int sz = at(to)->size();
+        add(from, -sz);
+        add(to, sz);
+        at(to)->slot = to;
     }
 };
 
-template <class T>
-class block {
+// The elements of a run of blocks as contiguous spans, in order: one per
+// block, or two where its ring wraps around. U is T or const T.
+template <class T, class U>
+class segment_view {
    public:
-    T **arr;
-    int front;  // reachable
-    int rear;   // unreachable
-    int capacity;
-    block(size_t cap = DEFAULT_BLOCK_SIZE) : front(0), rear(0), capacity(cap) {
-        arr = new T *[capacity];
-        for (size_t i = 0; i < capacity; ++i) {
-            arr[i] = nullptr;
-        }
-    }
-    block(const block<T> *other) {
-        if (other != nullptr) {
-            this->capacity = other->capacity;
-            this->front = other->front;
-            this->rear = other->rear;
-            this->arr = new T *[capacity];
-        }
-        for (size_t i = 0; i < capacity; ++i) {
-            if (other->arr[i] == nullptr) {
-                this->arr[i] = nullptr;
-            } else {
-                this->arr[i] = new T(*(other->arr[i]));
+    class iterator {
+       public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef span<U> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+        typedef span<U> reference;
+
+        iterator() : p(nullptr), part(0) {}
+        iterator(block<T> *const *p, int part) : p(p), part(part) {}
+        span<U> operator*() const {
+            const block<T> *b = *p;
+            if (part == 1) {
+                return span<U>(b->arr, b->rear);
             }
+            int end = b->front < b->rear ? b->rear : b->capacity;
+            return span<U>(b->arr + b->front, end - b->front);
         }
-    }
-    // return size of current elements
-    size_t size() const { return (rear - front + capacity) % capacity; }
-    // calculate dist
-    int dist(int start, int end) const {
-        return (end - start + capacity) % capacity;
-    }
-    ~block() {
-        // std::cout << "block destructor" << std::endl;
-        for (int i = 0; i < capacity; ++i) {
-            if (arr[i] == nullptr) {
-                continue;
+        iterator &operator++() {
+            const block<T> *b = *p;
+            if (part == 0 && b->front > b->rear && b->rear > 0) {
+                part = 1;
+            } else {
+                ++p;
+                part = 0;
             }
-            delete arr[i];
-            arr[i] = nullptr;
+            return *this;
         }
-        delete[] arr;
-        arr = nullptr;
-        front = rear = 0;
-    }
+        iterator operator++(int) {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const iterator &rhs) const {
+            return p == rhs.p && part == rhs.part;
+        }
+        bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+       private:
+        block<T> *const *p;
+        int part;  // 1 for the part of a wrapped block at the array start
+    };
+
+    segment_view() : from(nullptr), to(nullptr) {}
+    // the non-empty blocks in [from, to)
+    segment_view(block<T> *const *from, block<T> *const *to)
+        : from(from), to(to) {}
+    iterator begin() const { return iterator(from, 0); }
+    iterator end() const { return iterator(to, 0); }
+
+   private:
+    block<T> *const *from;
+    block<T> *const *to;
 };
 
-template <class T>
+template <class T, class Allocator = std::allocator<T>,
+          class BlockPolicy = sqrt_blocks>
 class deque {
+    typedef std::allocator_traits<Allocator> alloc_traits;
+    typedef typename alloc_traits::template rebind_alloc<
+        block_map<T, Allocator> >
+        map_alloc;
+    typedef std::allocator_traits<map_alloc> map_traits;
+
    public:
-    double_list<block<T> *> *list;  // store pointer to current doublelist
+    typedef Allocator allocator_type;
+    typedef BlockPolicy block_policy;
+    typedef segment_view<T, T> segment_range;
+    typedef segment_view<T, const T> const_segment_range;
+    block_map<T, Allocator> *map;  // directory of the blocks, in order
     int totalsize = 0;
+    Allocator alloc;  // source of every block, element and the map itself
+    int lowmark = 0;   // BlockPolicy::low for sizes in [markfrom, 2 * markfrom)
+    int markfrom = 0;
+
+    // capacity for a new block, as BlockPolicy sees the deque now
+    size_t fresh_capacity() const {
+        return BlockPolicy::capacity(sizeof(T), totalsize);
+    }
+    // the low watermark, asked of BlockPolicy only when the size has
+    // crossed a power of two since the last time
+    int low_watermark() {
+        if (totalsize < markfrom || totalsize >= 2 * markfrom) {
+            markfrom = round_down_pow2(totalsize);
+            lowmark = BlockPolicy::low(sizeof(T), markfrom);
+        }
+        return lowmark;
+    }
+    // whether lhs and rhs are small enough to merge: the merged block must
+    // be left at most half full, so it is far from being split again
+    bool mergeable(const block<T> *lhs, const block<T> *rhs) const {
+        size_t n = lhs->size() + rhs->size();
+        size_t room = std::max(lhs->capacity, rhs->capacity);
+        return 2 * n <= std::max(room, round_up_pow2(BlockPolicy::merged(
+                                           n, sizeof(T), totalsize)));
+    }
 
     // Merge two blocks into one larger block
     block<T> *merge(block<T> *lhs, block<T> *rhs) {
         // std::cout << "enter the merge func" << std::endl;
-        double factor = 2.0;
-        int cap = (lhs->size() + rhs->size()) * factor;
-        block<T> *newblock = new block<T>(cap);
+        block<T> *newblock = map->make(BlockPolicy::merged(
+            lhs->size() + rhs->size(), sizeof(T), totalsize));
         newblock->rear = lhs->size() + rhs->size();
         newblock->front = 0;
-        // Copy elements from the left block (lhs) to the new block
-        for (int i = 0; i < lhs->size(); ++i) {
-            newblock->arr[i] = (lhs->arr[(i + lhs->front) % lhs->capacity]);
-            (lhs->arr[(i + lhs->front) % lhs->capacity]) = nullptr;
-        }
-        // Copy elements from the right block (rhs) to the new block
-        for (int i = 0; i < rhs->size(); ++i) {
-            newblock->arr[i + lhs->size()] =
-                rhs->arr[(i + rhs->front) % rhs->capacity];
-            (rhs->arr[(i + rhs->front) % rhs->capacity]) = nullptr;
-        }
-        delete lhs;
-        delete rhs;
+        // Move elements from the left block (lhs), then the right block
+        // (rhs), to the new block
+        int n = lhs->size();
+        map->transfer(newblock, 0, lhs, lhs->front, n);
+        map->transfer(newblock, n, rhs, rhs->front, rhs->size());
+        lhs->front = lhs->rear = 0;
+        rhs->front = rhs->rear = 0;
+        map->drop(lhs);
+        map->drop(rhs);
         return newblock;
     }
     // Split a block into two smaller blocks
     block<T> *split(block<T> *to_split) {
-        double factor = 1.003;
         int cap = to_split->capacity, mid = to_split->size() / 2;
-        block<T> *lblock = new block<T>(cap);
+        block<T> *lblock = map->make(cap);
         lblock->rear = mid;
-        // Copy elements from the first half of the original block to the new
+        // Move elements from the first half of the original block to the new
         // block
-        for (int i = 0; i < lblock->rear; ++i) {
-            lblock->arr[i] =
-                to_split->arr[(i + to_split->front) % to_split->capacity];
-            to_split->arr[(i + to_split->front) % to_split->capacity] = nullptr;
-        }
-        to_split->front = (to_split->front + mid) % to_split->capacity;
+        map->transfer(lblock, 0, to_split, to_split->front, mid);
+        to_split->front = (to_split->front + mid) & to_split->mask;
         // delete to_split;
         return lblock;
     }
@@ -397,18 +1268,43 @@ class deque {
          * just add whatever you want.
          */
        public:
-        // Internal iterator for traversing the doublelist
-        typename double_list<block<T> *>::iterator iter;
-        double_list<block<T> *> *mylist;
+        // lets the standard algorithms and iterator_traits use it
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T *pointer;
+        typedef T &reference;
+
+        block_map<T, Allocator> *mymap;
+        block<T> *cur;
         int idx;
         T *p_val;
-        iterator() : mylist(nullptr), idx(0), p_val(nullptr), iter(nullptr) {}
-        iterator(double_list<block<T> *> *mylist,
-                 const typename double_list<block<T> *>::iterator &it,
-                 int index, T *p_val)
-            : mylist(mylist), iter(it), idx(index), p_val(p_val) {}
-        /*
-         * return a new iterator which points to the n-next element.
+        iterator() : mymap(nullptr), cur(nullptr), idx(0), p_val(nullptr) {}
+        iterator(block_map<T, Allocator> *mymap, block<T> *cur, int index,
+                 T *p_val)
+            : mymap(mymap), cur(cur), idx(index), p_val(p_val) {}
+        // global position of the element this iterator points to
+        int position() const {
+            return mymap->prefix(cur->slot) + cur->dist(cur->front, idx);
+        }
+        // move to global position pos, which may be the end position
+        iterator &seek(int pos) {
+            if (pos < 0 || pos > mymap->total()) {
+                throw "invalid";
+            }
+            if (pos == mymap->total()) {
+                cur = mymap->tail();
+                idx = cur->rear;
+                p_val = nullptr;
+                return *this;
+            }
+            cur = mymap->at(mymap->locate(pos));
+            idx = (cur->front + pos) & cur->mask;
+            p_val = cur->arr + idx;
+            return *this;
+        }
+        /**
+         * return a new iterator which points to the n-next element.
          * if there are not enough elements, the behaviour is undefined.
          * same for operator-.
          */
@@ -416,102 +1312,38 @@ class deque {
             if (n < 0) {
                 return *this - (-n);
             }
-            iterator tmp = *this;
-            int remain = n;
-            if (tmp.iter.cur == nullptr || tmp.mylist == nullptr) {
-                // std::cout << "in iterator operator+ tmp.iter.cur == nullptr"
-                //           << std::endl;
+            if (cur == nullptr || mymap == nullptr) {
                 throw "invalid";
             }
-
-            while (remain > 0) {
-                if (tmp.iter.cur == nullptr) {
-                    // std::cout
-                    //     << "in iterator operator+ tmp.iter.cur == nullptr 2"
-                    //     << std::endl;
-                    throw "invalid";
-                }
-                if (tmp.iter.cur->data == nullptr) {
-                    // std::cout << "in iterator operator+ curblock == nullptr"
-                    //           << std::endl;
-                    throw "Invalid block";
-                }
-                int mod = tmp.iter.cur->data->capacity;
-                int avil = (tmp.iter.cur->data->dist(
-                               tmp.idx, tmp.iter.cur->data->rear)) %
-                           mod;
-
-                if (remain < avil) {
-                    tmp.idx = (tmp.idx + remain) % tmp.iter.cur->data->capacity;
-                    remain = 0;
-                } else {
-                    remain -= (avil);
-                    if (tmp.iter == tmp.mylist->get_tail()) {
-                        if (remain == 0) {
-                            tmp.idx = tmp.iter.cur->data->rear;
-                            tmp.p_val = nullptr;
-                            return tmp;
-                        } else {
-                            throw "invalid";
-                        }
-                    } else
-                        tmp.iter++;
-                    tmp.idx = tmp.iter.cur->data->front;
-                }
+            if (n == 0) {
+                return *this;
             }
-            tmp.p_val = (tmp.iter.cur->data->arr)[tmp.idx];
-            return tmp;
+            iterator tmp = *this;
+            // stay inside the current block when possible
+            if (n < cur->dist(idx, cur->rear)) {
+                tmp.idx = (idx + n) & cur->mask;
+                tmp.p_val = cur->arr + tmp.idx;
+                return tmp;
+            }
+            return tmp.seek(position() + n);
         }
         iterator operator-(const int &n) const {
             if (n < 0) {
                 return *this + (-n);
             }
-            iterator tmp = *this;
-            int remain = n;
-            if (tmp.iter.cur == nullptr || tmp.mylist == nullptr) {
-                // std::cout << "in iterator operator- tmp.iter.cur == nullptr"
-                //           << std::endl;
+            if (cur == nullptr || mymap == nullptr) {
                 throw "invalid";
             }
-            block<T> *curblock = tmp.iter.cur->data;
-
-            while (remain > 0) {
-                if (tmp.iter.cur == nullptr) {
-                    // std::cout
-                    //     << "in iterator operator- tmp.iter.cur == nullptr 2"
-                    //     << std::endl;
-                    throw "invalid";
-                }
-                if (tmp.iter.cur->data == nullptr) {
-                    // std::cout << "in iterator operator- curblock == nullptr"
-                    //           << std::endl;
-                    throw "Invalid block";
-                }
-                int avil = tmp.iter.cur->data->dist(tmp.iter.cur->data->front,
-                                                    tmp.idx);
-                if (tmp.iter == tmp.mylist->get_head() && remain > avil) {
-                    // std::cout << "in iterator operator- exceed begin()"
-                    //           << std::endl;
-                    throw "Invalid";
-                }
-                if (remain <= avil) {
-                    tmp.idx =
-                        (tmp.idx - remain + tmp.iter.cur->data->capacity) %
-                        tmp.iter.cur->data->capacity;
-                    remain = 0;
-                } else {
-                    remain -= (avil + 1);
-                    if (tmp.iter == tmp.mylist->get_head()) {
-                        throw "invalid";
-                    } else
-                        tmp.iter--;
-                    tmp.idx = (tmp.iter.cur->data->rear - 1 +
-                               tmp.iter.cur->data->capacity) %
-                              tmp.iter.cur->data->capacity;
-                }
+            if (n == 0) {
+                return *this;
             }
-            tmp.p_val = tmp.iter.cur->data->arr[tmp.idx];
-            return tmp;
+            iterator tmp = *this;
+            if (n <= cur->dist(cur->front, idx)) {
+                tmp.idx = (idx - n) & cur->mask;
+                tmp.p_val = cur->arr + tmp.idx;
+                return tmp;
+            }
+            return tmp.seek(position() - n);
         }
 
         /**
@@ -520,36 +1352,15 @@ class deque {
          * invaild_iterator.
          */
         int operator-(const iterator &rhs) const {
-            if (this->mylist != rhs.mylist) {
+            if (this->mymap != rhs.mymap) {
                 // std::cout << "oh" << std::endl;
                 throw "invaild_iterator";
             }
-            iterator tmp = *this;
-            int ans1 = 0, ans2 = 0;
-            if (tmp.iter.cur == nullptr || rhs.iter.cur == nullptr) {
+            if (cur == nullptr || rhs.cur == nullptr) {
                 // std::cout << "in int operator-  cur nullptr" << std::endl;
                 throw "Iterator out of range";
             }
-            block<T> *block1 = (tmp).iter.cur->data;
-            block<T> *block2 = (rhs).iter.cur->data;
-            if (block1 == nullptr || block2 == nullptr) {
-                // std::cout << "in int operator-  block nullptr" << std::endl;
-                throw "Invalid block";
-            }
-            ans1 += block1->dist(tmp.idx, block1->rear);
-            ans2 += block2->dist(rhs.idx, block2->rear);
-            while (tmp.iter != tmp.mylist->get_tail()) {
-                ++(tmp.iter);
-                block1 = tmp.iter.cur->data;
-                ans1 += block1->size();
-            }
-            tmp = rhs;
-            while (tmp.iter != tmp.mylist->get_tail()) {
-                ++(tmp.iter);
-                block2 = tmp.iter.cur->data;
-                ans2 += block2->size();
-            }
-            return ans2 - ans1;
+            return position() - rhs.position();
         }
         iterator &operator+=(const int &n) {
             *this = (*this) + n;
@@ -611,7 +1422,7 @@ class deque {
          * memory).
          */
         bool operator==(const iterator &rhs) const {
-            if (iter.cur != rhs.iter.cur) {
+            if (cur != rhs.cur) {
                 return false;
             } else if (idx != rhs.idx || p_val != rhs.p_val) {
                 return false;
@@ -619,7 +1430,7 @@ class deque {
             return true;
         }
         bool operator==(const const_iterator &rhs) const {
-            if (iter.cur != rhs.iter.cur) {
+            if (cur != rhs.cur) {
                 return false;
             } else if (idx != rhs.idx || p_val != rhs.p_val) {
                 return false;
@@ -642,16 +1453,42 @@ class deque {
          * just add whatever you want.
          */
        public:
-        typename double_list<block<T> *>::iterator iter;
-        double_list<block<T> *> *mylist;
+        // lets the standard algorithms and iterator_traits use it
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        block_map<T, Allocator> *mymap;
+        block<T> *cur;
         int idx;
         T *p_val;
         const_iterator()
-            : mylist(nullptr), idx(0), p_val(nullptr), iter(nullptr) {}
-        const_iterator(double_list<block<T> *> *mylist,
-                       const typename double_list<block<T> *>::iterator &it,
-                       int index, T *p_val)
-            : mylist(mylist), iter(it), idx(index), p_val(p_val) {}
+            : mymap(nullptr), cur(nullptr), idx(0), p_val(nullptr) {}
+        const_iterator(block_map<T, Allocator> *mymap, block<T> *cur, int index,
+                       T *p_val)
+            : mymap(mymap), cur(cur), idx(index), p_val(p_val) {}
+        // global position of the element this iterator points to
+        int position() const {
+            return mymap->prefix(cur->slot) + cur->dist(cur->front, idx);
+        }
+        // move to global position pos, which may be the end position
+        const_iterator &seek(int pos) {
+            if (pos < 0 || pos > mymap->total()) {
+                throw "invalid";
+            }
+            if (pos == mymap->total()) {
+                cur = mymap->tail();
+                idx = cur->rear;
+                p_val = nullptr;
+                return *this;
+            }
+            cur = mymap->at(mymap->locate(pos));
+            idx = (cur->front + pos) & cur->mask;
+            p_val = cur->arr + idx;
+            return *this;
+        }
         /**
          * return a new iterator which points to the n-next element.
          * if there are not enough elements, the behaviour is undefined.
@@ -661,109 +1498,38 @@ class deque {
             if (n < 0) {
                 return *this - (-n);
             }
-            const_iterator tmp = *this;
-            int remain = n;
-            if (tmp.iter.cur == nullptr || tmp.mylist == nullptr) {
-                // std::cout
-                //     << "in const_iterator operator+ tmp.iter.cur == nullptr"
-                //     << std::endl;
+            if (cur == nullptr || mymap == nullptr) {
                 throw "invalid";
             }
-
-            while (remain > 0) {
-                if (tmp.iter.cur == nullptr) {
-                    // std::cout << "in const_iterator operator+ tmp.iter.cur ==
-                    // "
-                    //              "nullptr 2"
-                    //           << std::endl;
-                    throw "invalid";
-                }
-                if (tmp.iter.cur->data == nullptr) {
-                    // std::cout
-                    //     << "in const_iterator operator+ curblock == nullptr"
-                    //     << std::endl;
-                    throw "Invalid block";
-                }
-                int mod = tmp.iter.cur->data->capacity;
-                int avil = (tmp.iter.cur->data->dist(
-                               tmp.idx, tmp.iter.cur->data->rear)) %
-                           mod;
-
-                if (remain < avil) {
-                    tmp.idx = (tmp.idx + remain) % tmp.iter.cur->data->capacity;
-                    remain = 0;
-                } else {
-                    remain -= (avil);
-                    if (tmp.iter == tmp.mylist->get_tail()) {
-                        if (remain == 0) {
-                            tmp.idx = tmp.iter.cur->data->rear;
-                            tmp.p_val = nullptr;
-                            return tmp;
-                        } else {
-                            // std::cout << "OMG2" << std::endl;
-                            throw "invalid";
-                        }
-                    } else
-                        tmp.iter++;
-                    tmp.idx = tmp.iter.cur->data->front;
-                }
+            if (n == 0) {
+                return *this;
             }
-            tmp.p_val = (tmp.iter.cur->data->arr)[tmp.idx];
-            return tmp;
+            const_iterator tmp = *this;
+            // stay inside the current block when possible
+            if (n < cur->dist(idx, cur->rear)) {
+                tmp.idx = (idx + n) & cur->mask;
+                tmp.p_val = cur->arr + tmp.idx;
+                return tmp;
+            }
+            return tmp.seek(position() + n);
         }
         const_iterator operator-(const int &n) const {
             if (n < 0) {
                 return *this + (-n);
             }
-            const_iterator tmp = *this;
-            int remain = n;
-            if (tmp.iter.cur == nullptr || tmp.mylist == nullptr) {
-                // std::cout
-                //     << "in const_iterator operator- tmp.iter.cur == nullptr"
-                //     << std::endl;
+            if (cur == nullptr || mymap == nullptr) {
                 throw "invalid";
             }
-            block<T> *curblock = tmp.iter.cur->data;
-
-            while (remain > 0) {
-                if (tmp.iter.cur == nullptr) {
-                    // std::cout << "in const_iterator operator- tmp.iter.cur ==
-                    // "
-                    //              "nullptr 2"
-                    //           << std::endl;
-                    throw "invalid";
-                }
-                if (tmp.iter.cur->data == nullptr) {
-                    // std::cout
-                    //     << "in const_iterator operator- curblock == nullptr"
-                    //     << std::endl;
-                    throw "Invalid block";
-                }
-                int avil = tmp.iter.cur->data->dist(tmp.iter.cur->data->front,
-                                                    tmp.idx);
-                if (tmp.iter == tmp.mylist->get_head() && remain > avil) {
-                    // std::cout << "in const_iterator operator- exceed begin()"
-                    //           << std::endl;
-                    throw "Invalid";
-                }
-                if (remain <= avil) {
-                    tmp.idx =
-                        (tmp.idx - remain + tmp.iter.cur->data->capacity) %
-                        tmp.iter.cur->data->capacity;
-                    remain = 0;
-                } else {
-                    remain -= (avil + 1);
-                    if (tmp.iter == tmp.mylist->get_head()) {
-                        throw "invalid";
-                    } else
-                        tmp.iter--;
-                    tmp.idx = (tmp.iter.cur->data->rear - 1 +
-                               tmp.iter.cur->data->capacity) %
-                              tmp.iter.cur->data->capacity;
-                }
+            if (n == 0) {
+                return *this;
             }
-            tmp.p_val = tmp.iter.cur->data->arr[tmp.idx];
-            return tmp;
+            const_iterator tmp = *this;
+            if (n <= cur->dist(cur->front, idx)) {
+                tmp.idx = (idx - n) & cur->mask;
+                tmp.p_val = cur->arr + tmp.idx;
+                return tmp;
+            }
+            return tmp.seek(position() - n);
         }
 
         /**
@@ -772,36 +1538,15 @@ class deque {
          * invaild_const_iterator.
          */
         int operator-(const const_iterator &rhs) const {
-            if (this->mylist != rhs.mylist) {
+            if (this->mymap != rhs.mymap) {
                 // std::cout << "oh" << std::endl;
                 throw "invaild_iterator";
             }
-            const_iterator tmp = *this;
-            int ans1 = 0, ans2 = 0;
-            if (tmp.iter.cur == nullptr || rhs.iter.cur == nullptr) {
+            if (cur == nullptr || rhs.cur == nullptr) {
                 // std::cout << "in int operator-  cur nullptr" << std::endl;
                 throw "const_iterator out of range";
             }
-            block<T> *block1 = (tmp).iter.cur->data;
-            block<T> *block2 = (rhs).iter.cur->data;
-            if (block1 == nullptr || block2 == nullptr) {
-                // std::cout << "in int operator-  block nullptr" << std::endl;
-                throw "Invalid block";
-            }
-            ans1 += block1->dist(tmp.idx, block1->rear);
-            ans2 += block2->dist(rhs.idx, block2->rear);
-            while (tmp.iter != tmp.mylist->get_tail()) {
-                ++(tmp.iter);
-                block1 = tmp.iter.cur->data;
-                ans1 += block1->size();
-            }
-            tmp = rhs;
-            while (tmp.iter != tmp.mylist->get_tail()) {
-                ++(tmp.iter);
-                block2 = tmp.iter.cur->data;
-                ans2 += block2->size();
-            }
-            return ans2 - ans1;
+            return position() - rhs.position();
         }
         const_iterator &operator+=(const int &n) {
             *this = (*this) + n;
@@ -863,7 +1608,7 @@ class deque {
          * memory).
          */
         bool operator==(const iterator &rhs) const {
-            if (iter.cur != rhs.iter.cur) {
+            if (cur != rhs.cur) {
                 return false;
             } else if (idx != rhs.idx || p_val != rhs.p_val) {
                 return false;
@@ -871,7 +1616,7 @@ class deque {
             return true;
         }
         bool operator==(const const_iterator &rhs) const {
-            if (iter.cur != rhs.iter.cur) {
+            if (cur != rhs.cur) {
                 return false;
             } else if (idx != rhs.idx || p_val != rhs.p_val) {
                 return false;
@@ -890,20 +1635,26 @@ class deque {
     /**
      * constructors.
      */
-    deque() {
-        list = new double_list<block<T> *>;
-        block<T> *block1 = new block<T>();
-        list->insert_tail(block1);
-    }
-    deque(const deque &other) {
-        list = new double_list<block<T> *>;
-        typename double_list<block<T> *>::iterator it = other.list->begin();
-        while (it != other.list->end()) {
-            block<T> *newblock = new block<T>(*it);
-            list->insert_tail(newblock);
-            ++it;
-        }
-        totalsize = other.totalsize;
+    deque() : deque(Allocator()) {}
+    explicit deque(const Allocator &alloc) : map(nullptr), alloc(alloc) {
+        map = new_map(alloc);
+    }
+    deque(const deque &other)
+        : deque(other, alloc_traits::select_on_container_copy_construction(
+                           other.alloc)) {}
+    deque(const deque &other, const Allocator &alloc)
+        : map(nullptr), totalsize(other.totalsize), alloc(alloc) {
+        map = other.map != nullptr ? new_map(alloc, *other.map)
+                                   : new_map(alloc);
+    }
+    /**
+     * take over the blocks of other in O(1). other is left empty and gets
+     * a block again when it is next used.
+     */
+    deque(deque &&other) noexcept
+        : map(other.map), totalsize(other.totalsize), alloc(other.alloc) {
+        other.map = nullptr;
+        other.totalsize = 0;
     }
 
     /**
@@ -911,33 +1662,125 @@ class deque {
      */
     ~deque() {
         // std::cout<<"~deque" << std::endl;
-        // for(auto x=list->get_head();x!=list->end();++x){
-        //     delete x.cur->data;
-        // }
-        delete list;
-        list = nullptr;
+        delete_map(map);
+        map = nullptr;
+    }
+
+    // A directory allocated from a, holding copies of the blocks of the
+    // directory passed in from, or a single empty block
+    template <class... From>
+    block_map<T, Allocator> *new_map(const Allocator &a,
+                                     const From &...from) {
+        map_alloc mapalloc(a);
+        block_map<T, Allocator> *m = map_traits::allocate(mapalloc, 1);
+        try {
+            new (m) block_map<T, Allocator>(from..., a);
+        } catch (...) {
+            map_traits::deallocate(mapalloc, m, 1);
+            throw;
+        }
+        if (m->count() == 0) {
+            try {
+                m->push_back(m->make(BlockPolicy::capacity(sizeof(T), 0)));
+            } catch (...) {
+                delete_map(m);
+                throw;
+            }
+        }
+        return m;
+    }
+    // the directory, made again for a deque whose blocks were moved away.
+    // a moved-from deque is never const, so the cast is safe
+    block_map<T, Allocator> *ready() const {
+        if (map == nullptr) {
+            deque *self = const_cast<deque *>(this);
+            self->map = self->new_map(alloc);
+        }
+        return map;
+    }
+    void delete_map(block_map<T, Allocator> *m) {
+        if (m == nullptr) {
+            return;
+        }
+        map_alloc mapalloc(m->alloc);
+        m->~block_map();
+        map_traits::deallocate(mapalloc, m, 1);
     }
 
     /**
      * assignment operator.
+     * the allocator follows the propagate_on_container_* traits; when the
+     * blocks of other cannot be taken over, its elements are moved.
      */
     deque &operator=(const deque &other) {
         if (&other == this) {
             return *this;
         }
-        delete list;
-        totalsize = 0;
-        list = new double_list<block<T> *>;
-        typename double_list<block<T> *>::iterator otherit =
-            other.list->begin();
-        while (otherit != other.list->end()) {
-            block<T> *newblock = new block<T>(*otherit);
-            list->insert_tail(newblock);
-            ++otherit;
-        }
+        const Allocator &next =
+            alloc_traits::propagate_on_container_copy_assignment::value
+                ? other.alloc
+                : alloc;
+        block_map<T, Allocator> *newmap = other.map != nullptr
+                                              ? new_map(next, *other.map)
+                                              : new_map(next);
+        delete_map(map);
+        map = newmap;
         totalsize = other.totalsize;
+        take_alloc(other.alloc,
+                   typename alloc_traits::
+                       propagate_on_container_copy_assignment());
         return *this;
     }
+    deque &operator=(deque &&other) noexcept(
+        alloc_traits::propagate_on_container_move_assignment::value) {
+        if (&other == this) {
+            return *this;
+        }
+        if (alloc_traits::propagate_on_container_move_assignment::value ||
+            alloc == other.alloc) {
+            delete_map(map);
+            map = other.map;
+            totalsize = other.totalsize;
+            take_alloc(other.alloc,
+                       typename alloc_traits::
+                           propagate_on_container_move_assignment());
+            other.map = nullptr;
+            other.totalsize = 0;
+        } else {
+            clear();
+            if (other.map != nullptr) {
+                insert(end(), std::make_move_iterator(other.begin()),
+                       std::make_move_iterator(other.end()));
+                other.clear();
+            }
+        }
+        return *this;
+    }
+    void take_alloc(const Allocator &other, std::true_type) {
+        alloc = other;
+    }
+    void take_alloc(const Allocator &, std::false_type) {}
+
+    /**
+     * return a copy of the allocator.
+     */
+    Allocator get_allocator() const { return alloc; }
+
+    /**
+     * exchange the contents of two deques in O(1).
+     * iterators keep pointing to the same elements.
+     */
+    void swap(deque &other) noexcept {
+        std::swap(map, other.map);
+        std::swap(totalsize, other.totalsize);
+        swap_alloc(other,
+                   typename alloc_traits::propagate_on_container_swap());
+    }
+    void swap_alloc(deque &other, std::true_type) {
+        using std::swap;
+        swap(alloc, other.alloc);
+    }
+    void swap_alloc(deque &, std::false_type) {}
 
     /**
      * access a specified element with bound checking.
@@ -999,26 +1842,26 @@ class deque {
      * return an iterator to the beginning.
      */
     iterator begin() {
-        block<T> *block1 = list->begin().cur->data;
-        return iterator(list, list->begin(), block1->front,
-                        block1->arr[block1->front]);
+        block<T> *block1 = ready()->head();
+        return iterator(map, block1, block1->front,
+                        block1->get(block1->front));
     }
     const_iterator cbegin() const {
-        block<T> *block1 = list->begin().cur->data;
-        return const_iterator(list, list->begin(), block1->front,
-                              block1->arr[block1->front]);
+        block<T> *block1 = ready()->head();
+        return const_iterator(map, block1, block1->front,
+                              block1->get(block1->front));
     }
 
     /**
      * return an iterator to the end.
      */
     iterator end() {
-        block<T> *block1 = list->get_tail().cur->data;
-        return iterator(list, list->get_tail(), block1->rear, nullptr);
+        block<T> *block1 = ready()->tail();
+        return iterator(map, block1, block1->rear, nullptr);
     }
     const_iterator cend() const {
-        block<T> *block1 = list->get_tail().cur->data;
-        return const_iterator(list, list->get_tail(), block1->rear, nullptr);
+        block<T> *block1 = ready()->tail();
+        return const_iterator(map, block1, block1->rear, nullptr);
     }
 
     /**
@@ -1031,16 +1874,122 @@ class deque {
      */
     size_t size() const { return totalsize; }
 
+    /**
+     * block geometry: the fewest and the most elements BlockPolicy puts in a
+     * new block of T, fixed at compile time, the capacity the next new block
+     * gets and the number of blocks in use.
+     */
+    static constexpr size_t min_block_capacity() {
+        return BlockPolicy::min_capacity(sizeof(T));
+    }
+    static constexpr size_t max_block_capacity() {
+        return BlockPolicy::max_capacity(sizeof(T));
+    }
+    size_t next_block_capacity() const {
+        return round_up_pow2(fresh_capacity());
+    }
+    size_t block_count() const { return map == nullptr ? 0 : map->count(); }
+
+    /**
+     * the elements in order as contiguous spans (std::span under C++20),
+     * one per block or two where a block wraps around, for loops the
+     * compiler can vectorise. the spans are invalidated like iterators.
+     */
+    segment_range segments() {
+        if (map == nullptr || totalsize == 0) {
+            return segment_range();
+        }
+        return segment_range(map->where(map->first), map->where(map->last));
+    }
+    const_segment_range segments() const {
+        if (map == nullptr || totalsize == 0) {
+            return const_segment_range();
+        }
+        return const_segment_range(map->where(map->first),
+                                   map->where(map->last));
+    }
+    /**
+     * call f on each span of segments(), in order.
+     */
+    template <class F>
+    void for_each_segment(F f) {
+        for (span<T> s : segments()) {
+            f(s);
+        }
+    }
+    template <class F>
+    void for_each_segment(F f) const {
+        for (span<const T> s : segments()) {
+            f(s);
+        }
+    }
+
+    /**
+     * give back the memory the deque does not need: the elements are packed
+     * into full blocks of the size BlockPolicy picks now, the last one no
+     * larger than needed, in a directory just large enough. blocks set
+     * aside by reserve_front() and reserve_back() are freed. a throwing move
+     * leaves the deque as it was; iterators are invalidated.
+     */
+    void shrink_to_fit() {
+        if (map == nullptr) {
+            return;
+        }
+        int depth = map->depth;
+        if (totalsize == 0) {
+            map->unreserve();
+            map->cache(0);
+            map->clear();
+            map->cache(depth);
+            map->push_back(map->make(fresh_capacity()));
+            return;
+        }
+        int cap = round_up_pow2(fresh_capacity());
+        block_map<T, Allocator> *m = new_map(alloc);
+        try {
+            // keep nothing of the placeholder block, but the setting
+            m->cache(0);
+            m->erase(m->first);
+            m->cache(depth);
+            iterator it = begin();
+            for (int left = totalsize; left > 0;) {
+                int n = std::min(left, cap - 1);
+                block<T> *b = m->make(
+                    n == left ? std::max(min_block_capacity(), size_t(n + 1))
+                              : cap);
+                try {
+                    for (; b->rear < n; ++b->rear, ++it) {
+                        m->construct(b->arr + b->rear,
+                                     std::move_if_noexcept(*it));
+                    }
+                    m->push_back(b);
+                } catch (...) {
+                    m->drop(b);
+                    throw;
+                }
+                left -= n;
+            }
+        } catch (...) {
+            delete_map(m);
+            throw;
+        }
+        delete_map(map);
+        map = m;
+    }
+
     /**
      * clear all contents.
      */
     void clear() {
+        if (map == nullptr) {
+            // moved-from deque, give it a block again
+            map = new_map(alloc);
+            return;
+        }
         if (totalsize == 0) return;
-        delete list;
-        list = new double_list<block<T> *>;
+        map->clear();
         totalsize = 0;
-        block<T> *block1 = new block<T>();
-        list->insert_tail(block1);
+        map->push_back(map->make(fresh_capacity()));
     }
 
     /**
@@ -1049,86 +1998,353 @@ class deque {
      * throw if the iterator is invalid or it points to a wrong place.
      */
     iterator insert(iterator pos, const T &value) {
-        if (pos.mylist != list) {
+        return emplace(pos, value);
+    }
+    iterator insert(iterator pos, T &&value) {
+        return emplace(pos, std::move(value));
+    }
+
+    /**
+     * construct an element in place before pos from args.
+     * return an iterator pointing to the new element.
+     * throw if the iterator is invalid or it points to a wrong place.
+     */
+    template <class... Args>
+    iterator emplace(iterator pos, Args &&...args) {
+        if (pos.mymap != map) {
             // std::cout << "xiba" << std::endl;
             throw "invalid";
         }
-        if (pos.iter == nullptr) {
+        if (pos.cur == nullptr) {
             throw "invalid";
         }
-        block<T> *curblock = pos.iter.cur->data;
-        ++totalsize;
+        // at either end of the deque a full block gets a new neighbour, as
+        // on a push, and splitting is left to inserts in the middle
+        if (pos.cur == map->tail() && pos.idx == pos.cur->rear) {
+            emplace_back(std::forward<Args>(args)...);
+            block<T> *tail = map->tail();
+            int idx = (tail->rear - 1) & tail->mask;
+            return iterator(map, tail, idx, tail->arr + idx);
+        }
+        if (pos.cur == map->head() && pos.idx == pos.cur->front) {
+            emplace_front(std::forward<Args>(args)...);
+            block<T> *head = map->head();
+            return iterator(map, head, head->front, head->arr + head->front);
+        }
+        if (pos.cur->size() >= BlockPolicy::limit(pos.cur->capacity)) {
+            // args may refer to an element of the block about to be split,
+            // so build the value before anything moves
+            T value(std::forward<Args>(args)...);
+            return place(make_room(pos), std::move(value));
+        }
+        return place(pos, std::forward<Args>(args)...);
+    }
+
+    // Split the block of pos when nearly full, return pos in its new block
+    iterator make_room(iterator pos) {
+        block<T> *curblock = pos.cur;
         // Find the target position in the current block
         int target = curblock->dist(curblock->front, pos.idx);
-        if (curblock->size() >= curblock->capacity - 2) {
-            // Split the block when nearly full
-            block<T> *newblock = split(curblock);
-            // Insert the new block in the list
-            list->insert(pos.iter, newblock);
-            if (target < newblock->size()) {
-                curblock = newblock;
-                newblock = nullptr;
-                pos.iter--;
-            } else {
-                target = target - newblock->size();
-            }
+        block<T> *newblock = split(curblock);
+        // Insert the new block in front of it
+        map->grow(curblock->slot, -int(newblock->size()));
+        map->insert(curblock->slot, newblock);
+        if (target < int(newblock->size())) {
+            curblock = newblock;
+        } else {
+            target = target - newblock->size();
         }
-        int mod = curblock->capacity;
+        pos.cur = curblock;
+        pos.idx = (curblock->front + target) & curblock->mask;
+        return pos;
+    }
+
+    // Construct an element before pos, whose block must have a free slot
+    template <class... Args>
+    iterator place(iterator pos, Args &&...args) {
+        block<T> *curblock = pos.cur;
+        int mask = curblock->mask;
         int nowrear = curblock->rear;
         int nowfront = curblock->front;
-        int posidx = (target + curblock->front) % mod;
-        // std::cout << "front " << curblock->front << std::endl;
-        int tmpidx = nowrear;  // Temporary index for traversing the block
+        int posidx = pos.idx;
         // If the insertion is at the rear position
         if (posidx == nowrear) {
-            curblock->rear = (nowrear + 1) % mod;
-            if (curblock->arr[nowrear]) {
-                *(curblock->arr[nowrear]) = value;
+            map->construct(curblock->arr + nowrear,
+                           std::forward<Args>(args)...);
+            curblock->rear = (nowrear + 1) & mask;
+            pos.idx = nowrear;
+            pos.p_val = curblock->arr + nowrear;
+        } else if (posidx == nowfront) {
+            // If the insertion is at the front position
+            int newfront = (nowfront - 1) & mask;
+            map->construct(curblock->arr + newfront,
+                           std::forward<Args>(args)...);
+            curblock->front = newfront;
+            pos.p_val = curblock->arr + newfront;
+            pos.idx = curblock->front;
+        } else {
+            // If inserting in the middle, shift the shorter side of the
+            // block, the elements before pos down or those from pos up, and
+            // insert the value in the slot freed next to pos
+            T value(std::forward<Args>(args)...);
+            int before = curblock->dist(nowfront, posidx);
+            int after = curblock->dist(posidx, nowrear);
+            if (before < after) {
+                map->shift(curblock, nowfront, before, -1);
+                curblock->front = (nowfront - 1) & mask;
+                posidx = (posidx - 1) & mask;
             } else {
-                curblock->arr[nowrear] = new T(value);
+                map->shift(curblock, posidx, after, 1);
+                curblock->rear = (nowrear + 1) & mask;
             }
-            pos.idx = nowrear;
-            pos.p_val = curblock->arr[nowrear];
-            return pos;
+            map->construct(curblock->arr + posidx, std::move(value));
+            pos.p_val = curblock->arr + posidx;
+            pos.idx = posidx;
         }
-        // If the insertion is at the front position
-        if (posidx == nowfront) {
-            curblock->front = (nowfront - 1 + mod) % mod;
-            // std::cout << "again front " << curblock->front << std::endl;
+        ++totalsize;
+        map->grow(curblock->slot, 1);
+        return pos;
+    }
 
-            if (curblock->arr[curblock->front]) {
-                *(curblock->arr[curblock->front]) = value;
-            } else {
-                curblock->arr[curblock->front] = new T(value);
-            }
-            pos.p_val = curblock->arr[curblock->front];
-            // std::cout<<std::endl;
-            //  for (int i = 0; i < curblock->capacity; ++i) {
-            //           if (curblock->arr[i] != nullptr)
-            //               std::cout << *(curblock->arr[i]) << " ";
-            //           else
-            //               std::cout << "NULL ";
-            //       }
-            pos.idx = curblock->front;
+    /**
+     * insert the elements of [first, last) before pos.
+     * return an iterator pointing to the first inserted element, or pos
+     * when the range is empty. the elements are built straight into
+     * blocks, so this takes O(n + #blocks) instead of n single inserts.
+     */
+    template <class InputIt,
+              class = typename std::enable_if<
+                  !std::is_integral<InputIt>::value>::type>
+    iterator insert(iterator pos, InputIt first, InputIt last) {
+        if (pos.mymap != map || pos.cur == nullptr) {
+            throw "invalid";
+        }
+        return insert_range(
+            pos, first, last,
+            typename std::iterator_traits<InputIt>::iterator_category());
+    }
+    /**
+     * insert n copies of value before pos.
+     * return an iterator pointing to the first inserted element, or pos
+     * when n is 0.
+     */
+    iterator insert(iterator pos, size_t n, const T &value) {
+        if (pos.mymap != map || pos.cur == nullptr) {
+            throw "invalid";
+        }
+        // value may live in the part of the block moved aside
+        T copy(value);
+        return insert_n(pos, n, value_source{map, &copy});
+    }
+
+    /**
+     * add the elements of [first, last) to the end.
+     */
+    template <class InputIt,
+              class = typename std::enable_if<
+                  !std::is_integral<InputIt>::value>::type>
+    void append(InputIt first, InputIt last) {
+        insert(end(), first, last);
+    }
+
+    /**
+     * replace the contents with the elements of [first, last), or with n
+     * copies of value.
+     */
+    template <class InputIt,
+              class = typename std::enable_if<
+                  !std::is_integral<InputIt>::value>::type>
+    void assign(InputIt first, InputIt last) {
+        clear();
+        insert(end(), first, last);
+    }
+    void assign(size_t n, const T &value) {
+        T copy(value);
+        clear();
+        insert(end(), n, copy);
+    }
+
+    // Forward ranges are counted first and built in one pass
+    template <class It>
+    iterator insert_range(iterator pos, It first, It last,
+                          std::forward_iterator_tag) {
+        return insert_n(pos, std::distance(first, last),
+                        range_source<It>{map, first});
+    }
+    // Single-pass ranges are gathered in a scratch deque, then moved in
+    template <class It>
+    iterator insert_range(iterator pos, It first, It last,
+                          std::input_iterator_tag) {
+        deque scratch(alloc);
+        for (; first != last; ++first) {
+            scratch.push_back(*first);
+        }
+        typedef std::move_iterator<iterator> mover;
+        return insert_n(pos, scratch.totalsize,
+                        range_source<mover>{map, mover(scratch.begin())});
+    }
+
+    // Sources for insert_n: each call constructs k elements at dst, and
+    // destroys the ones it built if one of them throws
+    template <class It>
+    struct range_source {
+        block_map<T, Allocator> *map;
+        It it;
+        void operator()(T *dst, int k) {
+            build(dst, k,
+                  std::integral_constant<
+                      bool, std::is_pointer<It>::value &&
+                                std::is_trivially_copyable<T>::value &&
+                                plain_construct<Allocator>::value &&
+                                std::is_same<typename std::remove_cv<
+                                                 typename std::remove_pointer<
+                                                     It>::type>::type,
+                                             T>::value>());
+        }
+        // plain arrays of trivially copyable elements are copied as bytes
+        void build(T *dst, int k, std::true_type) {
+            std::memcpy(dst, it, k * sizeof(T));
+            it += k;
+        }
+        void build(T *dst, int k, std::false_type) {
+            int i = 0;
+            try {
+                for (; i < k; ++i, ++it) {
+                    map->construct(dst + i, *it);
+                }
+            } catch (...) {
+                while (i > 0) {
+                    map->destroy(dst + --i);
+                }
+                throw;
+            }
+        }
+    };
+    struct value_source {
+        block_map<T, Allocator> *map;
+        const T *value;
+        void operator()(T *dst, int k) {
+            int i = 0;
+            try {
+                for (; i < k; ++i) {
+                    map->construct(dst + i, *value);
+                }
+            } catch (...) {
+                while (i > 0) {
+                    map->destroy(dst + --i);
+                }
+                throw;
+            }
+        }
+    };
+
+    // How full insert_n leaves a block: as full as the push paths at the
+    // end of the deque, half full elsewhere so later inserts have room
+    static int fill_level(int cap, bool at_end) {
+        return at_end ? cap - 1 : cap / 2;
+    }
+
+    // Insert n elements made by src before pos. The elements after pos are
+    // moved aside, the block of pos is topped up, the rest go into fresh
+    // blocks that are linked in with one directory update, and the moved
+    // elements are put back behind them.
+    template <class Source>
+    iterator insert_n(iterator pos, int n, Source src) {
+        if (n <= 0) {
             return pos;
         }
-        // If inserting in the middle, shift elements and insert the value at
-        // the correct position
-        while (tmpidx != posidx) {
-            if (curblock->arr[tmpidx]) {
-                *(curblock->arr[tmpidx]) =
-                    *(curblock->arr[(tmpidx - 1 + mod) % mod]);
-            } else {
-                curblock->arr[tmpidx] =
-                    new T(*(curblock->arr[(tmpidx - 1 + mod) % mod]));
+        int at = pos.position();
+        block<T> *cur = pos.cur;
+        int target = cur->dist(cur->front, pos.idx);
+        int tailn = cur->size() - target;
+        bool at_end = tailn == 0 && map->next(cur) == nullptr;
+        // number of new elements that go into cur
+        int k = fill_level(cur->capacity, at_end) - target;
+        if (target + n + tailn <= int(BlockPolicy::limit(cur->capacity))) {
+            k = n;
+        }
+        k = std::max(0, std::min(k, n));
+        int cap = fresh_capacity();
+        int fill = fill_level(cap, at_end);
+        int m = (n - k + fill - 1) / fill;
+        block<T> **fresh = map->make_slots(m + 1);
+        block<T> *rest = nullptr;
+        if (tailn > 0) {
+            try {
+                rest = map->make(cur->capacity);
+            } catch (...) {
+                map->free_slots(fresh, m + 1);
+                throw;
             }
-            tmpidx = (tmpidx - 1 + mod) % mod;
+            move_back(rest, cur, pos.idx, tailn);
+            cur->rear = pos.idx;
+            map->grow(cur->slot, -tailn);
+        }
+        int built = 0;
+        block<T> *b = nullptr;
+        try {
+            fill_back(cur, k, src);
+            for (int i = 0; i < m; ++i) {
+                b = map->make(cap);
+                fill_back(b, (n - k) / m + (i < (n - k) % m), src);
+                fresh[built++] = b;
+                b = nullptr;
+            }
+        } catch (...) {
+            map->drop(b);
+            link_filled(cur, target, fresh, built, rest);
+            map->free_slots(fresh, m + 1);
+            throw;
+        }
+        block<T> *back = built > 0 ? fresh[built - 1] : cur;
+        if (rest != nullptr &&
+            back->size() + tailn <= BlockPolicy::limit(back->capacity)) {
+            move_back(back, rest, 0, tailn);
+            rest->rear = rest->front;
+            map->drop(rest);
+            rest = nullptr;
+        }
+        link_filled(cur, target, fresh, built, rest);
+        map->free_slots(fresh, m + 1);
+        iterator res(map, cur, 0, nullptr);
+        return res.seek(at);
+    }
+
+    // Move k elements of from, starting at slot idx, to the rear of to.
+    // the caller shrinks from
+    void move_back(block<T> *to, block<T> *from, int idx, int k) {
+        map->transfer(to, to->rear, from, idx, k);
+        to->rear = (to->rear + k) & to->mask;
+    }
+
+    // Construct k elements made by src at the rear of b
+    template <class Source>
+    void fill_back(block<T> *b, int k, Source &src) {
+        while (k > 0) {
+            int run = std::min(k, b->capacity - b->rear);
+            src(b->arr + b->rear, run);
+            b->rear = (b->rear + run) & b->mask;
+            k -= run;
         }
-        *(curblock->arr[tmpidx]) = value;
-        curblock->rear = (nowrear + 1) % mod;
-        pos.p_val = (curblock->arr[tmpidx]);
-        pos.idx = tmpidx;
-        return pos;
+    }
+
+    // Record what insert_n built: cur grew from before elements, and
+    // fresh[0, built) and then rest go right behind it. fresh must have
+    // room for rest
+    void link_filled(block<T> *cur, int before, block<T> **fresh, int built,
+                     block<T> *rest) {
+        map->grow(cur->slot, int(cur->size()) - before);
+        if (rest != nullptr) {
+            fresh[built++] = rest;
+        }
+        if (built > 0) {
+            map->insert(cur->slot + 1, fresh, built);
+        }
+        // a source that threw straight away may leave cur empty
+        if (cur->size() == 0 && map->count() > 1) {
+            map->erase(cur->slot);
+        }
+        totalsize = map->total();
     }
 
     /**
@@ -1138,123 +2354,418 @@ class deque {
      * the iterator is invalid, or it points to a wrong place.
      */
     iterator erase(iterator pos) {
-        if (pos.mylist != list) {
+        if (pos.mymap != map) {
             // std::cout << "cao" << std::endl;
             throw "invalid";
         }
-        if (pos.iter == nullptr) {
+        if (pos.cur == nullptr) {
             // std::cout << "cao?" << std::endl;
             throw "invalid";
         }
-        int target =
-            pos.iter.cur->data->dist(pos.iter.cur->data->front, pos.idx);
-        
-            // Merging blocks if the block size is too small
-        if (pos.iter.cur->data->size() < std::sqrt(totalsize) / 2) {
-            // std::cout<<"merge!!!"<<std::endl;
-            if (pos.iter.cur->next != nullptr) {
-                block<T> *newblock =
-                    merge(pos.iter.cur->data, pos.iter.cur->next->data);
-                pos.iter.cur->data = newblock;
-                typename double_list<block<T> *>::iterator iter1(
-                    pos.iter.cur->next);
-                // delete pos.iter.cur->next->data;
-                pos.iter.cur->next->data = nullptr;
-                pos.iter = list->erase(iter1);
+        block<T> *curblock = pos.cur;
+        int target = curblock->dist(curblock->front, pos.idx);
+
+        // a block below the low watermark is merged with its smaller
+        // neighbour
+        if (int(curblock->size()) < low_watermark()) {
+            block<T> *prevblock = map->prev(curblock);
+            block<T> *nextblock = map->next(curblock);
+            if (prevblock != nullptr &&
+                (nextblock == nullptr ||
+                 prevblock->size() < nextblock->size())) {
+                if (mergeable(prevblock, curblock)) {
+                    target += prevblock->size();
+                    curblock = merge_next(prevblock);
+                }
+            } else if (nextblock != nullptr &&
+                       mergeable(curblock, nextblock)) {
+                curblock = merge_next(curblock);
             }
         }
+        curblock = compact(curblock);
 
-        --totalsize;
-        int nowrear = pos.iter.cur->data->rear;
-        int mod = pos.iter.cur->data->capacity;
-        int posidx = (target + pos.iter.cur->data->front) % mod;
-        if (posidx == pos.iter.cur->data->rear) {
+        int nowrear = curblock->rear;
+        int mask = curblock->mask;
+        int posidx = (target + curblock->front) & mask;
+        if (posidx == curblock->rear) {
             // std::cout << "iterator erase(iterator pos) end()" << std::endl;
             throw "invalid";
         }
-        delete pos.iter.cur->data->arr[posidx];
-        pos.iter.cur->data->arr[posidx] = nullptr;
-        // update the front index and adjust the block 
+        --totalsize;
+        map->grow(curblock->slot, -1);
+        pos.cur = curblock;
+        // update the front index and adjust the block
         // if the position is at the front
-        if (posidx == pos.iter.cur->data->front) {
-            pos.iter.cur->data->front = (pos.iter.cur->data->front + 1) % mod;
-            if (pos.iter.cur->data->front == pos.iter.cur->data->rear) {
-                if (pos.mylist->get_tail() == pos.iter && totalsize != 0) {
-                    list->erase(pos.iter);
+        if (posidx == curblock->front) {
+            map->destroy(curblock->arr + posidx);
+            curblock->front = (curblock->front + 1) & mask;
+            if (curblock->front == curblock->rear) {
+                if (totalsize == 0) {
+                    map->clear();
+                    map->push_back(map->make(fresh_capacity()));
                     return end();
                 }
-                auto nextit = pos.iter.cur->next;
-                list->erase(pos.iter);
-                if (totalsize == 0) {
-                    block<T> *block1 = new block<T>();
-                    list->insert_tail(block1);
+                block<T> *nextblock = map->next(curblock);
+                map->erase(curblock->slot);
+                if (nextblock == nullptr) {
                     return end();
                 }
-                pos.iter = nextit;
-                // pos.idx = 0;
-                // pos.p_val = nullptr;
-            }
-            pos.idx = pos.iter.cur->data->front;
-            pos.p_val = pos.iter.cur->data->arr[pos.iter.cur->data->front];
-            // std::cout << std::endl;
-            //  for (int i = 0; i < pos.iter.cur->data->capacity; ++i) {
-            //      if (pos.iter.cur->data->arr[i] != nullptr)
-            //          std::cout << *(pos.iter.cur->data->arr[i]) << " ";
-            //      else
-            //          std::cout << "NULL ";
-            //  }
+                curblock = pos.cur = nextblock;
+            }
+            pos.idx = curblock->front;
+            pos.p_val = curblock->arr + curblock->front;
             return pos;
         }
-        // update the rear index if the position is at the rea
-        if (posidx == (nowrear - 1 + pos.iter.cur->data->capacity) %
-                          pos.iter.cur->data->capacity) {
-            if (pos.mylist->get_tail() == pos.iter) {
-                pos.iter.cur->data->rear = (nowrear - 1 + mod) % mod;
-                pos.p_val = nullptr;
-                if (pos.iter.cur->data->front == pos.iter.cur->data->rear) {
-                    pos.iter = list->erase(pos.iter);
-                }
-                // std::cout << std::endl;
-                //  for (int i = 0; i < pos.iter.cur->data->capacity; ++i) {
-                //      if (pos.iter.cur->data->arr[i] != nullptr)
-                //          std::cout << *(pos.iter.cur->data->arr[i]) << " ";
-                //      else
-                //          std::cout << "NULL ";
-                //  }
-                // pos.idx = 0;
-                // pos.p_val = nullptr;
+        // update the rear index if the position is at the rear
+        if (posidx == ((nowrear - 1) & mask)) {
+            map->destroy(curblock->arr + posidx);
+            curblock->rear = (nowrear - 1) & mask;
+            block<T> *nextblock = map->next(curblock);
+            if (nextblock == nullptr) {
                 return end();
             }
-
-            pos.iter.cur->data->rear = (nowrear - 1 + mod) % mod;
-            // std::cout << std::endl;
-            //  for (int i = 0; i < pos.iter.cur->data->capacity; ++i) {
-            //      if (pos.iter.cur->data->arr[i] != nullptr)
-            //          std::cout << *(pos.iter.cur->data->arr[i]) << " ";
-            //      else
-            //          std::cout << "NULL ";
-            //  }
-            pos.iter++;
-            pos.p_val = pos.iter.cur->data->arr[pos.iter.cur->data->front];
-            pos.idx = pos.iter.cur->data->front;
+            pos.cur = nextblock;
+            pos.p_val = nextblock->arr + nextblock->front;
+            pos.idx = nextblock->front;
             return pos;
         }
-        // Shift the elements and remove the value at the target position
-        pos.p_val = pos.iter.cur->data->arr[(posidx + 1) % mod];
-        pos.idx = (posidx) % mod;
-        while (posidx != nowrear) {
-            pos.iter.cur->data->arr[posidx] =
-                pos.iter.cur->data->arr[(posidx + 1) % mod];
-            posidx = (posidx + 1) % mod;
+        // Remove the value at the target position and close the gap from
+        // the shorter side: the elements before it move up, or those after
+        // it move down
+        map->destroy(curblock->arr + posidx);
+        int next = (posidx + 1) & mask;
+        int after = curblock->dist(next, nowrear);
+        if (target < after) {
+            map->shift(curblock, curblock->front, target, 1);
+            curblock->front = (curblock->front + 1) & mask;
+            posidx = next;
+        } else {
+            map->shift(curblock, next, after, -1);
+            curblock->rear = (nowrear - 1) & mask;
         }
-        pos.iter.cur->data->rear = (nowrear - 1 + mod) % mod;
+        pos.p_val = curblock->arr + posidx;
+        pos.idx = posidx;
         return pos;
     }
 
+    /**
+     * remove the elements in [first, last).
+     * return an iterator pointing to the element that followed them, or
+     * end(). blocks inside the range are dropped whole, the two blocks at
+     * its ends are trimmed once and merged at most once, so this takes
+     * O(k + #blocks) instead of k single erases.
+     * throw if an iterator is invalid or last comes before first.
+     */
+    iterator erase(iterator first, iterator last) {
+        if (first.mymap != map || last.mymap != map) {
+            throw "invalid";
+        }
+        if (first.cur == nullptr || last.cur == nullptr) {
+            throw "invalid";
+        }
+        int at = first.position();
+        int k = last.position() - at;
+        if (k < 0) {
+            throw "invalid";
+        }
+        if (k == 0) {
+            return last;
+        }
+        totalsize -= k;
+        if (totalsize == 0) {
+            map->clear();
+            map->push_back(map->make(fresh_capacity()));
+            return end();
+        }
+        block<T> *lblock = first.cur;
+        block<T> *rblock = last.cur;
+        if (lblock == rblock) {
+            erase_inside(lblock, first.idx, last.idx);
+        } else {
+            // cut the tail of the first block and the head of the last one
+            map->destroy(lblock, first.idx, lblock->rear);
+            map->grow(lblock->slot, -lblock->dist(first.idx, lblock->rear));
+            lblock->rear = first.idx;
+            map->destroy(rblock, rblock->front, last.idx);
+            map->grow(rblock->slot, -rblock->dist(rblock->front, last.idx));
+            rblock->front = last.idx;
+            // drop every block in between, and the two if now empty
+            std::ptrdiff_t from = lblock->slot + (lblock->size() > 0 ? 1 : 0);
+            std::ptrdiff_t to = rblock->slot + (rblock->size() > 0 ? 0 : 1);
+            if (lblock->size() == 0) {
+                lblock = map->prev(lblock);
+            }
+            if (rblock->size() == 0) {
+                rblock = map->next(rblock);
+            }
+            map->erase(from, to - from);
+            // the blocks now meeting at the cut may be merged once
+            if (lblock != nullptr && rblock != nullptr &&
+                int(std::min(lblock->size(), rblock->size())) <
+                    low_watermark() &&
+                mergeable(lblock, rblock)) {
+                lblock = merge_next(lblock);
+                rblock = nullptr;
+            }
+            if (lblock != nullptr) {
+                compact(lblock);
+            }
+            if (rblock != nullptr) {
+                compact(rblock);
+            }
+        }
+        iterator res(map, map->head(), 0, nullptr);
+        return res.seek(at);
+    }
+
+    // Remove the elements in slots [from, to) of b, which stays non-empty
+    // or is dropped
+    void erase_inside(block<T> *b, int from, int to) {
+        int k = b->dist(from, to);
+        map->grow(b->slot, -k);
+        if (from == b->front) {
+            map->destroy(b, from, to);
+            b->front = to;
+        } else {
+            // destroy the range, then close the gap from the shorter side
+            int before = b->dist(b->front, from);
+            int after = b->dist(to, b->rear);
+            map->destroy(b, from, to);
+            if (before < after) {
+                map->shift(b, b->front, before, k);
+                b->front = (b->front + k) & b->mask;
+            } else {
+                map->shift(b, to, after, -k);
+                b->rear = (from + after) & b->mask;
+            }
+        }
+        if (b->size() == 0) {
+            map->erase(b->slot);
+        } else {
+            compact(b);
+        }
+    }
+
+    // Erasures leave a block sparse when it is used below 1/COMPACT_RATIO
+    // of its capacity and larger than the policy's smallest block. Rewrite
+    // such a block into one of about twice its size; that one is at least a
+    // quarter used, so the work is paid for by the erasures that come before
+    // it turns sparse again. Return the block now holding the elements.
+    static const int COMPACT_RATIO = 8;
+    block<T> *compact(block<T> *b) {
+        if (b->capacity <= int(min_block_capacity()) ||
+            int(b->size()) * COMPACT_RATIO >= b->capacity) {
+            return b;
+        }
+        int n = b->size();
+        block<T> *res =
+            map->make(std::max(min_block_capacity(), size_t(2 * n)));
+        map->transfer(res, 0, b, b->front, n);
+        res->rear = n;
+        b->front = b->rear = 0;
+        map->replace(b->slot, res);
+        map->drop(b);
+        return res;
+    }
+
+    // Merge b with the block after it in the directory, return the result.
+    // When the larger of the two has room, the elements of the other move
+    // into it and no block is allocated
+    block<T> *merge_next(block<T> *b) {
+        block<T> *nb = map->next(b);
+        int n = b->size() + nb->size();
+        if (2 * n <= b->capacity && b->capacity >= nb->capacity) {
+            int k = nb->size();
+            map->transfer(b, b->rear, nb, nb->front, k);
+            b->rear = (b->rear + k) & b->mask;
+            nb->front = nb->rear = 0;
+            map->grow(b->slot, k);
+            map->grow(nb->slot, -k);
+            map->erase(nb->slot);
+            return b;
+        }
+        if (2 * n <= nb->capacity) {
+            int k = b->size();
+            nb->front = (nb->front - k) & nb->mask;
+            map->transfer(nb, nb->front, b, b->front, k);
+            b->front = b->rear = 0;
+            map->grow(nb->slot, k);
+            map->grow(b->slot, -k);
+            map->erase(b->slot);
+            return nb;
+        }
+        std::ptrdiff_t slot = b->slot;
+        block<T> *newblock = merge(b, map->next(b));
+        map->replace(slot, newblock);
+        // merge() already deleted the right block
+        map->at(slot + 1) = nullptr;
+        map->erase(slot + 1);
+        return newblock;
+    }
+
+    /**
+     * move the elements from pos to the end into a new deque and return
+     * it. only the block holding pos is split; the blocks after it are
+     * handed over as they are, so this takes O(#blocks) whatever the
+     * number of elements moved. iterators from pos on are invalidated.
+     * throw if the iterator is invalid.
+     */
+    deque split_at(iterator pos) {
+        if (pos.mymap != map || pos.cur == nullptr) {
+            throw "invalid";
+        }
+        deque res(alloc);
+        std::ptrdiff_t s = cut(pos);
+        res.adopt(res.map->last, *this, s, map->last - s);
+        return res;
+    }
+
+    /**
+     * move all the elements of other to the end (append) or to the
+     * beginning (prepend). the blocks of other are relinked, not copied,
+     * and other is left empty. iterators into other are invalidated.
+     */
+    void append(deque &&other) { splice(end(), std::move(other)); }
+    void prepend(deque &&other) { splice(begin(), std::move(other)); }
+
+    /**
+     * move all the elements of other before pos, relinking its blocks.
+     * return an iterator pointing to the first moved element, or pos when
+     * other is empty. other is left empty. when the allocators differ the
+     * blocks cannot change hands and the elements are moved one by one.
+     * throw if the iterator is invalid.
+     */
+    iterator splice(iterator pos, deque &&other) {
+        if (pos.mymap != map || pos.cur == nullptr || &other == this) {
+            throw "invalid";
+        }
+        if (other.totalsize == 0) {
+            return pos;
+        }
+        if (!(alloc == other.alloc)) {
+            iterator res = insert(pos, std::make_move_iterator(other.begin()),
+                                  std::make_move_iterator(other.end()));
+            other.clear();
+            return res;
+        }
+        int at = pos.position();
+        adopt(cut(pos), other, other.map->first, other.map->count());
+        iterator res(map, map->head(), 0, nullptr);
+        return res.seek(at);
+    }
+
+    // Make pos the first element of its block, splitting the block there
+    // if needed. return the slot of that block, or map->last for end()
+    std::ptrdiff_t cut(iterator pos) {
+        block<T> *b = pos.cur;
+        if (pos.idx == b->rear) {
+            // only the end iterator sits at a rear
+            return map->last;
+        }
+        if (pos.idx == b->front) {
+            return b->slot;
+        }
+        block<T> *rest = map->make(b->capacity);
+        int k = b->dist(pos.idx, b->rear);
+        move_back(rest, b, pos.idx, k);
+        b->rear = pos.idx;
+        map->grow(b->slot, -k);
+        map->insert(b->slot + 1, rest);
+        return rest->slot;
+    }
+
+    // Move the k blocks in slots [s, s + k) of other right before slot at,
+    // keeping both deques free of empty blocks but for a lone one
+    void adopt(std::ptrdiff_t at, deque &other, std::ptrdiff_t s, int k) {
+        int moved = other.map->prefix(s + k) - other.map->prefix(s);
+        if (moved == 0) {
+            return;
+        }
+        if (totalsize == 0) {
+            map->erase(map->first);
+            at = map->first;
+        }
+        map->insert(at, other.map->where(s), k);
+        other.map->release(s, k);
+        totalsize += moved;
+        other.totalsize -= moved;
+        if (other.map->count() == 0) {
+            other.map->push_back(other.map->make(other.fresh_capacity()));
+        }
+    }
+
+    /**
+     * make sure the next n push_back() (or push_front()) calls allocate
+     * nothing: empty blocks for them are set aside now, with room in the
+     * directory. blocks emptied at either end are then kept, up to what
+     * was reserved, instead of freed, so a deque that stays within its
+     * reservation never allocates after warm-up. shrink_to_fit() gives the
+     * reservation back.
+     */
+    void reserve_back(size_t n) { reserve(1, n); }
+    void reserve_front(size_t n) { reserve(0, n); }
+
+    // set aside blocks for n more elements at end e, 0 the front, 1 the back
+    void reserve(int e, size_t n) {
+        ready();
+        // a lone block is both ends, so its room cannot be promised to one
+        block<T> *b = e == 1 ? map->tail() : map->head();
+        size_t room = map->count() > 1 ? b->capacity - 1 - b->size() : 0;
+        size_t cap = round_up_pow2(fresh_capacity());
+        size_t need = n > room ? n - room : 0;
+        map->reserve(e, (need + cap - 2) / (cap - 1), cap);
+    }
+
+    /**
+     * keep up to n blocks emptied by pops and erasures, besides the ones
+     * reserve_back() and reserve_front() hold, and reuse them for pushes
+     * at either end: a deque used as a queue then stops allocating once
+     * warm. SPARE_BLOCKS by default; 0 frees blocks as soon as they empty.
+     * shrink_to_fit() frees the blocks kept.
+     */
+    void set_spare_blocks(size_t n) {
+        ready()->cache(n);
+    }
+    size_t spare_blocks() const {
+        return map == nullptr ? SPARE_BLOCKS : map->depth;
+    }
+
     /**
      * add an element to the end.
      */
-    void push_back(const T &value) { insert(end(), value); }
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+    /**
+     * construct an element at the end, return a reference to it.
+     * only the tail block is touched; when it is full a new block is
+     * appended instead of splitting it.
+     */
+    template <class... Args>
+    T &emplace_back(Args &&...args) {
+        block<T> *tail = ready()->tail();
+        if (int(tail->size()) + 1 >= tail->capacity) {
+            tail = map->take_spare();
+            if (tail == nullptr) {
+                tail = map->make(fresh_capacity());
+            }
+            try {
+                map->construct(tail->arr, std::forward<Args>(args)...);
+            } catch (...) {
+                map->retire(tail);
+                throw;
+            }
+            tail->rear = 1;
+            map->push_back(tail);
+        } else {
+            map->construct(tail->arr + tail->rear,
+                           std::forward<Args>(args)...);
+            tail->rear = (tail->rear + 1) & tail->mask;
+            ++map->taillag;
+        }
+        ++totalsize;
+        return tail->arr[(tail->rear - 1) & tail->mask];
+    }
 
     /**
      * remove the last element.
@@ -1265,13 +2776,56 @@ class deque {
             // std::cout << "pop_front() empty" << std::endl;
             throw "invalid";
         }
-        erase(end() - 1);
+        block<T> *tail = map->tail();
+        tail->rear = (tail->rear - 1) & tail->mask;
+        map->destroy(tail->arr + tail->rear);
+        --map->taillag;
+        --totalsize;
+        // keep no empty blocks, except the only one
+        if (tail->front == tail->rear && map->count() > 1) {
+            map->erase(tail->slot);
+        }
     }
 
     /**
      * insert an element to the beginning.
      */
-    void push_front(const T &value) { insert(begin(), value); }
+    void push_front(const T &value) { emplace_front(value); }
+    void push_front(T &&value) { emplace_front(std::move(value)); }
+
+    /**
+     * construct an element at the beginning, return a reference to it.
+     * only the head block is touched; when it is full a new block is
+     * prepended instead of splitting it.
+     */
+    template <class... Args>
+    T &emplace_front(Args &&...args) {
+        block<T> *head = ready()->head();
+        if (int(head->size()) + 1 >= head->capacity) {
+            head = map->take_spare();
+            if (head == nullptr) {
+                head = map->make(fresh_capacity());
+            }
+            int newfront = head->capacity - 1;
+            try {
+                map->construct(head->arr + newfront,
+                               std::forward<Args>(args)...);
+            } catch (...) {
+                map->retire(head);
+                throw;
+            }
+            head->front = newfront;
+            map->push_front(head);
+        } else {
+            int newfront = (head->front - 1) & head->mask;
+            map->construct(head->arr + newfront,
+                           std::forward<Args>(args)...);
+            head->front = newfront;
+            ++map->headlag;
+        }
+        ++totalsize;
+        return head->arr[head->front];
+    }
 
     /**
      * remove the first element.
@@ -1282,9 +2836,724 @@ class deque {
             // std::cout << "pop_front() empty" << std::endl;
             throw "invalid";
         }
-        erase(begin());
+        block<T> *head = map->head();
+        map->destroy(head->arr + head->front);
+        head->front = (head->front + 1) & head->mask;
+        --map->headlag;
+        --totalsize;
+        // keep no empty blocks, except the only one
+        if (head->front == head->rear && map->count() > 1) {
+            map->erase(head->slot);
+        }
     }
 };
 
+template <class T, class Allocator, class BlockPolicy>
+void swap(deque<T, Allocator, BlockPolicy> &lhs,
+          deque<T, Allocator, BlockPolicy> &rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+// Algorithms over a range of a deque that walk it a block at a time, so the
+// inner loops run over plain arrays without the checks of the iterators.
+
+// whether It is an iterator of some deque
+template <class It>
+class is_deque_iterator {
+    template <class I>
+    static std::true_type test(decltype(&I::cur), decltype(&I::mymap));
+    template <class I>
+    static std::false_type test(...);
+
+   public:
+    static const bool value = decltype(test<It>(nullptr, nullptr))::value;
+};
+template <class It, class R>
+using if_deque_iterator =
+    typename std::enable_if<is_deque_iterator<It>::value, R>::type;
+template <class It>
+using run_pointer = typename std::iterator_traits<It>::pointer;
+template <class It>
+using run_value = typename std::iterator_traits<It>::value_type;
+
+// call f(p, n) for each run of n elements lying next to each other at p in
+// [first, last), in order, until f returns false; return whether all ran
+template <class It, class F>
+bool each_run(It first, It last, F f) {
+    if (first == last) {
+        return true;
+    }
+    auto *b = first.cur;
+    int i = first.idx;
+    while (true) {
+        int end = b == last.cur ? last.idx : b->rear;
+        // the part of a wrapped block up to the end of its array
+        if (i > end) {
+            if (!f(run_pointer<It>(b->arr + i), b->capacity - i)) {
+                return false;
+            }
+            i = 0;
+        }
+        if (i < end && !f(run_pointer<It>(b->arr + i), end - i)) {
+            return false;
+        }
+        if (b == last.cur) {
+            return true;
+        }
+        b = first.mymap->next(b);
+        i = b->front;
+    }
+}
+// the number of elements lying next to each other from it on
+template <class It>
+int run_length(const It &it) {
+    const auto *b = it.cur;
+    if (b->front <= b->rear || it.idx < b->front) {
+        return b->rear - it.idx;
+    }
+    return b->capacity - it.idx;
+}
+
+// trivially copyable elements are copied as bytes; with memmove, since out
+// may lie before p in the same block, as std::copy allows
+template <class T>
+T *copy_plain(const T *p, int n, T *out, std::true_type) {
+    if (n > 0) {
+        std::memmove(out, p, n * sizeof(T));
+    }
+    return out + n;
+}
+template <class T>
+T *copy_plain(const T *p, int n, T *out, std::false_type) {
+    return std::copy(p, p + n, out);
+}
+// n elements from p to out, and where out ends up
+template <class T, class O>
+O copy_run(const T *p, int n, O out, std::false_type) {
+    for (int i = 0; i < n; ++i, ++out) {
+        *out = p[i];
+    }
+    return out;
+}
+template <class T>
+T *copy_run(const T *p, int n, T *out, std::false_type) {
+    return copy_plain(p, n, out, std::is_trivially_copyable<T>());
+}
+template <class T, class O>
+O copy_run(const T *p, int n, O out, std::true_type) {
+    while (n > 0) {
+        int k = std::min(n, run_length(out));
+        copy_run(p, k, out.p_val, std::false_type());
+        p += k;
+        n -= k;
+        out += k;
+    }
+    return out;
+}
+template <class T, class O>
+O copy_run(const T *p, int n, O out) {
+    return copy_run(p, n, out, std::integral_constant<
+                                   bool, is_deque_iterator<O>::value>());
+}
+
+// Kernels over the n elements of a run at p, for the element types that fit
+// SIMD lanes: 4 and 8 byte signed integers, float and double. On x86-64 they
+// use AVX2 when the CPU has it, found out at run time; elsewhere, and for
+// short runs, plain loops.
+template <class T>
+struct lane_kind
+    : std::integral_constant<
+          int, std::is_same<T, float>::value    ? 1
+               : std::is_same<T, double>::value ? 2
+               : !std::is_integral<T>::value || !std::is_signed<T>::value
+                   ? 0
+               : sizeof(T) == 4 ? 3
+               : sizeof(T) == 8 ? 4
+                                : 0> {};
+
+template <class T>
+struct plain_kernels {
+    static int find(const T *p, int n, T v) {
+        int i = 0;
+        while (i < n && !(p[i] == v)) {
+            ++i;
+        }
+        return i;
+    }
+    static int count(const T *p, int n, T v) {
+        int k = 0;
+        for (int i = 0; i < n; ++i) {
+            k += p[i] == v;
+        }
+        return k;
+    }
+    static T sum(const T *p, int n) {
+        T s = T();
+        for (int i = 0; i < n; ++i) {
+            s += p[i];
+        }
+        return s;
+    }
+    static bool equal(const T *p, const T *q, int n) {
+        return std::equal(p, p + n, q);
+    }
+    // the first smallest (Max false) or largest (Max true) of n > 0
+    template <bool Max>
+    static int extreme(const T *p, int n) {
+        int best = 0;
+        for (int i = 1; i < n; ++i) {
+            if (Max ? p[best] < p[i] : p[i] < p[best]) {
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+#if SJTU_DEQUE_SIMD
+#define SJTU_AVX2 __attribute__((target("avx2")))
+
+inline bool has_avx2() {
+    static const bool yes = __builtin_cpu_supports("avx2");
+    return yes;
+}
+
+// one AVX2 register of T, per lane_kind; eq gives a bit per equal lane
+template <class T, int Kind = lane_kind<T>::value>
+struct avx2_lanes;
+template <class T>
+struct avx2_lanes<T, 1> {
+    typedef __m256 vec;
+    static const int lanes = 8;
+    SJTU_AVX2 static vec load(const T *p) { return _mm256_loadu_ps(p); }
+    SJTU_AVX2 static vec splat(T v) { return _mm256_set1_ps(v); }
+    SJTU_AVX2 static int eq(vec a, vec b) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+    }
+    SJTU_AVX2 static int nan(vec a) {
+        return _mm256_movemask_ps(_mm256_cmp_ps(a, a, _CMP_UNORD_Q));
+    }
+    SJTU_AVX2 static vec add(vec a, vec b) { return _mm256_add_ps(a, b); }
+    SJTU_AVX2 static vec min(vec a, vec b) { return _mm256_min_ps(a, b); }
+    SJTU_AVX2 static vec max(vec a, vec b) { return _mm256_max_ps(a, b); }
+    SJTU_AVX2 static vec zero() { return _mm256_setzero_ps(); }
+    SJTU_AVX2 static void store(T *p, vec a) { _mm256_storeu_ps(p, a); }
+};
+template <class T>
+struct avx2_lanes<T, 2> {
+    typedef __m256d vec;
+    static const int lanes = 4;
+    SJTU_AVX2 static vec load(const T *p) { return _mm256_loadu_pd(p); }
+    SJTU_AVX2 static vec splat(T v) { return _mm256_set1_pd(v); }
+    SJTU_AVX2 static int eq(vec a, vec b) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+    }
+    SJTU_AVX2 static int nan(vec a) {
+        return _mm256_movemask_pd(_mm256_cmp_pd(a, a, _CMP_UNORD_Q));
+    }
+    SJTU_AVX2 static vec add(vec a, vec b) { return _mm256_add_pd(a, b); }
+    SJTU_AVX2 static vec min(vec a, vec b) { return _mm256_min_pd(a, b); }
+    SJTU_AVX2 static vec max(vec a, vec b) { return _mm256_max_pd(a, b); }
+    SJTU_AVX2 static vec zero() { return _mm256_setzero_pd(); }
+    SJTU_AVX2 static void store(T *p, vec a) { _mm256_storeu_pd(p, a); }
+};
+template <class T>
+struct avx2_lanes<T, 3> {
+    typedef __m256i vec;
+    static const int lanes = 8;
+    SJTU_AVX2 static vec load(const T *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    SJTU_AVX2 static vec splat(T v) { return _mm256_set1_epi32(v); }
+    SJTU_AVX2 static int eq(vec a, vec b) {
+        return _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)));
+    }
+    SJTU_AVX2 static int nan(vec) { return 0; }
+    SJTU_AVX2 static vec add(vec a, vec b) { return _mm256_add_epi32(a, b); }
+    SJTU_AVX2 static vec min(vec a, vec b) { return _mm256_min_epi32(a, b); }
+    SJTU_AVX2 static vec max(vec a, vec b) { return _mm256_max_epi32(a, b); }
+    SJTU_AVX2 static vec zero() { return _mm256_setzero_si256(); }
+    SJTU_AVX2 static void store(T *p, vec a) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a);
+    }
+};
+template <class T>
+struct avx2_lanes<T, 4> {
+    typedef __m256i vec;
+    static const int lanes = 4;
+    SJTU_AVX2 static vec load(const T *p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    SJTU_AVX2 static vec splat(T v) { return _mm256_set1_epi64x(v); }
+    SJTU_AVX2 static int eq(vec a, vec b) {
+        return _mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(a, b)));
+    }
+    SJTU_AVX2 static int nan(vec) { return 0; }
+    SJTU_AVX2 static vec add(vec a, vec b) { return _mm256_add_epi64(a, b); }
+    // no 64-bit min and max before AVX-512: pick by a compare
+    SJTU_AVX2 static vec min(vec a, vec b) {
+        return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+    }
+    SJTU_AVX2 static vec max(vec a, vec b) {
+        return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(b, a));
+    }
+    SJTU_AVX2 static vec zero() { return _mm256_setzero_si256(); }
+    SJTU_AVX2 static void store(T *p, vec a) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), a);
+    }
+};
+
+template <class T>
+struct avx2_kernels {
+    typedef avx2_lanes<T> V;
+    typedef typename V::vec vec;
+    static const int all = (1 << V::lanes) - 1;
+
+    SJTU_AVX2 static int find(const T *p, int n, T v) {
+        vec x = V::splat(v);
+        int i = 0;
+        for (; i + V::lanes <= n; i += V::lanes) {
+            int m = V::eq(V::load(p + i), x);
+            if (m != 0) {
+                return i + __builtin_ctz(m);
+            }
+        }
+        return i + plain_kernels<T>::find(p + i, n - i, v);
+    }
+    SJTU_AVX2 static int count(const T *p, int n, T v) {
+        vec x = V::splat(v);
+        int i = 0, k = 0;
+        for (; i + V::lanes <= n; i += V::lanes) {
+            k += __builtin_popcount(V::eq(V::load(p + i), x));
+        }
+        return k + plain_kernels<T>::count(p + i, n - i, v);
+    }
+    // the lanes are summed apart, so floating point sums are regrouped
+    SJTU_AVX2 static T sum(const T *p, int n) {
+        vec s = V::zero();
+        int i = 0;
+        for (; i + V::lanes <= n; i += V::lanes) {
+            s = V::add(s, V::load(p + i));
+        }
+        T lane[V::lanes];
+        V::store(lane, s);
+        T total = plain_kernels<T>::sum(p + i, n - i);
+        for (int j = 0; j < V::lanes; ++j) {
+            total += lane[j];
+        }
+        return total;
+    }
+    SJTU_AVX2 static bool equal(const T *p, const T *q, int n) {
+        int i = 0;
+        for (; i + V::lanes <= n; i += V::lanes) {
+            if (V::eq(V::load(p + i), V::load(q + i)) != all) {
+                return false;
+            }
+        }
+        return plain_kernels<T>::equal(p + i, q + i, n - i);
+    }
+    // the extreme value first, then where it first is; a NaN, which
+    // compares false with everything, sends the run to the plain loop
+    template <bool Max>
+    SJTU_AVX2 static int extreme(const T *p, int n) {
+        vec m = V::load(p);
+        int i = V::lanes, nan = V::nan(m);
+        for (; i + V::lanes <= n; i += V::lanes) {
+            vec x = V::load(p + i);
+            nan |= V::nan(x);
+            m = Max ? V::max(m, x) : V::min(m, x);
+        }
+        if (nan != 0) {
+            return plain_kernels<T>::template extreme<Max>(p, n);
+        }
+        T lane[V::lanes];
+        V::store(lane, m);
+        T best = lane[0];
+        for (int j = 1; j < V::lanes; ++j) {
+            best = (Max ? best < lane[j] : lane[j] < best) ? lane[j] : best;
+        }
+        for (; i < n; ++i) {
+            if (p[i] != p[i]) {
+                return plain_kernels<T>::template extreme<Max>(p, n);
+            }
+            best = (Max ? best < p[i] : p[i] < best) ? p[i] : best;
+        }
+        return find(p, n, best);
+    }
+};
+#endif
+
+// the kernels for T: AVX2 ones for runs of a few registers when the CPU
+// has it, the plain loops otherwise
+template <class T, bool Simd = SJTU_DEQUE_SIMD && lane_kind<T>::value != 0>
+struct kernels : plain_kernels<T> {};
+#if SJTU_DEQUE_SIMD
+template <class T>
+struct kernels<T, true> {
+    typedef plain_kernels<T> plain;
+    typedef avx2_kernels<T> wide;
+    static bool use_wide(int n) {
+        return n >= 4 * avx2_lanes<T>::lanes && has_avx2();
+    }
+    static int find(const T *p, int n, T v) {
+        return use_wide(n) ? wide::find(p, n, v) : plain::find(p, n, v);
+    }
+    static int count(const T *p, int n, T v) {
+        return use_wide(n) ? wide::count(p, n, v) : plain::count(p, n, v);
+    }
+    static T sum(const T *p, int n) {
+        return use_wide(n) ? wide::sum(p, n) : plain::sum(p, n);
+    }
+    static bool equal(const T *p, const T *q, int n) {
+        return use_wide(n) ? wide::equal(p, q, n) : plain::equal(p, q, n);
+    }
+    template <bool Max>
+    static int extreme(const T *p, int n) {
+        return use_wide(n) ? wide::template extreme<Max>(p, n)
+                           : plain::template extreme<Max>(p, n);
+    }
+};
+#endif
+// whether a value of type U can be looked for with the kernels for T: the
+// same type, or two signed integers
+template <class T, class U>
+struct kernel_value
+    : std::integral_constant<
+          bool, lane_kind<T>::value != 0 &&
+                    (std::is_same<T, U>::value ||
+                     (std::is_integral<T>::value &&
+                      std::is_integral<U>::value &&
+                      std::is_signed<U>::value))> {};
+
+// n copies of value at p; with memset when all bytes of value are the same
+template <class T>
+void fill_run(T *p, int n, const T &value, std::true_type) {
+    const unsigned char *bytes =
+        reinterpret_cast<const unsigned char *>(&value);
+    if (std::count(bytes, bytes + sizeof(T), bytes[0]) == sizeof(T)) {
+        std::memset(static_cast<void *>(p), bytes[0], n * sizeof(T));
+    } else {
+        std::fill(p, p + n, value);
+    }
+}
+template <class T>
+void fill_run(T *p, int n, const T &value, std::false_type) {
+    std::fill(p, p + n, value);
+}
+
+// n elements at p and at q; with the kernels when they are of one type
+template <class T, class U>
+bool equal_plain(const T *p, const U *q, int n) {
+    return std::equal(p, p + n, q);
+}
+template <class T>
+bool equal_plain(const T *p, const T *q, int n) {
+    return kernels<T>::equal(p, q, n);
+}
+// whether the n elements at p equal those from it on, moving it past them
+template <class T, class U>
+bool equal_run(const T *p, int n, U *&it, std::false_type) {
+    bool same = equal_plain(p, it, n);
+    it += n;
+    return same;
+}
+template <class T, class I>
+bool equal_run(const T *p, int n, I &it, std::false_type) {
+    for (int i = 0; i < n; ++i, ++it) {
+        if (!(p[i] == *it)) {
+            return false;
+        }
+    }
+    return true;
+}
+template <class T, class I>
+bool equal_run(const T *p, int n, I &it, std::true_type) {
+    while (n > 0) {
+        int k = std::min(n, run_length(it));
+        if (!equal_plain(p, it.p_val, k)) {
+            return false;
+        }
+        p += k;
+        n -= k;
+        it += k;
+    }
+    return true;
+}
+
+template <class It, class F>
+if_deque_iterator<It, F> for_each(It first, It last, F f) {
+    each_run(first, last, [&f](run_pointer<It> p, int n) -> bool {
+        for (int i = 0; i < n; ++i) {
+            f(p[i]);
+        }
+        return true;
+    });
+    return f;
+}
+
+template <class It, class Pred>
+if_deque_iterator<It, It> find_if(It first, It last, Pred pred) {
+    int k = 0;
+    bool found = !each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        for (int i = 0; i < n; ++i, ++k) {
+            if (pred(p[i])) {
+                return false;
+            }
+        }
+        return true;
+    });
+    return found ? first + k : last;
+}
+template <class It, class U>
+It find_value(It first, It last, const U &value, std::false_type) {
+    return find_if(first, last,
+                   [&value](const run_value<It> &x) { return x == value; });
+}
+template <class It, class U>
+It find_value(It first, It last, const U &value, std::true_type) {
+    typedef run_value<It> T;
+    const T v = T(value);
+    if (U(v) != value) {  // no T equals it, or it is a NaN
+        return last;
+    }
+    int k = 0;
+    bool found = !each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        int i = kernels<T>::find(p, n, v);
+        k += i;
+        return i == n;
+    });
+    return found ? first + k : last;
+}
+template <class It, class U>
+if_deque_iterator<It, It> find(It first, It last, const U &value) {
+    return find_value(first, last, value, kernel_value<run_value<It>, U>());
+}
+
+template <class It, class Pred>
+if_deque_iterator<It, std::ptrdiff_t> count_if(It first, It last, Pred pred) {
+    std::ptrdiff_t k = 0;
+    each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        for (int i = 0; i < n; ++i) {
+            k += pred(p[i]) ? 1 : 0;
+        }
+        return true;
+    });
+    return k;
+}
+template <class It, class U>
+std::ptrdiff_t count_value(It first, It last, const U &value,
+                           std::false_type) {
+    return count_if(first, last,
+                    [&value](const run_value<It> &x) { return x == value; });
+}
+template <class It, class U>
+std::ptrdiff_t count_value(It first, It last, const U &value,
+                           std::true_type) {
+    typedef run_value<It> T;
+    const T v = T(value);
+    std::ptrdiff_t k = 0;
+    if (U(v) != value) {
+        return 0;
+    }
+    each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        k += kernels<T>::count(p, n, v);
+        return true;
+    });
+    return k;
+}
+template <class It, class U>
+if_deque_iterator<It, std::ptrdiff_t> count(It first, It last,
+                                            const U &value) {
+    return count_value(first, last, value, kernel_value<run_value<It>, U>());
+}
+
+template <class It, class V, class Op>
+if_deque_iterator<It, V> accumulate(It first, It last, V init, Op op) {
+    each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        for (int i = 0; i < n; ++i) {
+            init = op(std::move(init), p[i]);
+        }
+        return true;
+    });
+    return init;
+}
+template <class It, class V>
+if_deque_iterator<It, V> accumulate(It first, It last, V init) {
+    return accumulate(first, last, std::move(init),
+                      [](V acc, const run_value<It> &x) { return acc + x; });
+}
+// like accumulate, in order, for a given op
+template <class It, class V, class Op>
+if_deque_iterator<It, V> reduce(It first, It last, V init, Op op) {
+    return accumulate(first, last, std::move(init), op);
+}
+template <class It, class V>
+V reduce_sum(It first, It last, V init, std::false_type) {
+    return accumulate(first, last, std::move(init));
+}
+template <class It, class V>
+V reduce_sum(It first, It last, V init, std::true_type) {
+    each_run(first, last, [&init](run_pointer<It> p, int n) -> bool {
+        init += kernels<V>::sum(p, n);
+        return true;
+    });
+    return init;
+}
+/**
+ * the sum of init and [first, last). like std::reduce the order of the
+ * additions is unspecified: sums of int, long, float or double of the
+ * element type are added up in SIMD lanes.
+ */
+template <class It, class V>
+if_deque_iterator<It, V> reduce(It first, It last, V init) {
+    return reduce_sum(first, last, std::move(init),
+                      std::integral_constant<
+                          bool, lane_kind<V>::value != 0 &&
+                                    std::is_same<V, run_value<It> >::value>());
+}
+template <class It>
+if_deque_iterator<It, run_value<It> > reduce(It first, It last) {
+    return accumulate(first, last, run_value<It>());
+}
+
+template <class It, class Less>
+if_deque_iterator<It, It> min_element(It first, It last, Less less) {
+    run_pointer<It> best = nullptr;
+    int at = -1, k = 0;
+    each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        for (int i = 0; i < n; ++i) {
+            if (best == nullptr || less(p[i], *best)) {
+                best = p + i;
+                at = k + i;
+            }
+        }
+        k += n;
+        return true;
+    });
+    return at < 0 ? last : first + at;
+}
+template <class It, class Less>
+if_deque_iterator<It, It> max_element(It first, It last, Less less) {
+    run_pointer<It> best = nullptr;
+    int at = -1, k = 0;
+    each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        for (int i = 0; i < n; ++i) {
+            if (best == nullptr || less(*best, p[i])) {
+                best = p + i;
+                at = k + i;
+            }
+        }
+        k += n;
+        return true;
+    });
+    return at < 0 ? last : first + at;
+}
+// the first smallest (Max false) or largest element, a run at a time
+template <bool Max, class It>
+It extreme_element(It first, It last, std::false_type) {
+    typedef run_value<It> T;
+    return min_element(first, last, [](const T &a, const T &b) {
+        return Max ? b < a : a < b;
+    });
+}
+template <bool Max, class It>
+It extreme_element(It first, It last, std::true_type) {
+    typedef run_value<It> T;
+    run_pointer<It> best = nullptr;
+    int at = -1, k = 0;
+    each_run(first, last, [&](run_pointer<It> p, int n) -> bool {
+        int i = kernels<T>::template extreme<Max>(p, n);
+        if (best != nullptr && !(p[i] == p[i])) {
+            // the run starts with a NaN, which the kernel keeps; weigh
+            // the rest against *best one by one
+            for (i = 1; i < n; ++i) {
+                if (Max ? *best < p[i] : p[i] < *best) {
+                    best = p + i;
+                    at = k + i;
+                }
+            }
+        } else if (best == nullptr || (Max ? *best < p[i] : p[i] < *best)) {
+            best = p + i;
+            at = k + i;
+        }
+        k += n;
+        return true;
+    });
+    return at < 0 ? last : first + at;
+}
+template <class It>
+if_deque_iterator<It, It> min_element(It first, It last) {
+    return extreme_element<false>(
+        first, last,
+        std::integral_constant<bool, lane_kind<run_value<It> >::value != 0>());
+}
+template <class It>
+if_deque_iterator<It, It> max_element(It first, It last) {
+    return extreme_element<true>(
+        first, last,
+        std::integral_constant<bool, lane_kind<run_value<It> >::value != 0>());
+}
+
+/**
+ * copy [first, last) to out, a block at a time: with memmove when out is a
+ * pointer to, or an iterator of a deque of, trivially copyable elements.
+ * out may point into [first, last) when it lies before first.
+ */
+template <class It, class O>
+if_deque_iterator<It, O> copy(It first, It last, O out) {
+    each_run(first, last, [&out](run_pointer<It> p, int n) -> bool {
+        out = copy_run(p, n, out);
+        return true;
+    });
+    return out;
+}
+template <class It, class O>
+if_deque_iterator<It, O> copy_n(It first, int n, O out) {
+    return n > 0 ? copy(first, first + n, out) : out;
+}
+
+/**
+ * assign value to [first, last): with memset when the elements are
+ * trivially copyable and every byte of value is the same, as for 0 or -1.
+ */
+template <class It, class U>
+if_deque_iterator<It, void> fill(It first, It last, const U &value) {
+    typedef run_value<It> T;
+    const T v = value;
+    each_run(first, last, [&v](T *p, int n) -> bool {
+        fill_run(p, n, v, std::is_trivially_copyable<T>());
+        return true;
+    });
+}
+
+/**
+ * whether [first, last) equals the range from first2 on; first2 may be any
+ * input iterator, and is walked a block at a time when it is a deque's too.
+ */
+template <class It, class I>
+if_deque_iterator<It, bool> equal(It first, It last, I first2) {
+    typedef std::integral_constant<bool, is_deque_iterator<I>::value> walk;
+    return each_run(first, last, [&first2](run_pointer<It> p, int n) {
+        return equal_run(p, n, first2, walk());
+    });
+}
+
+namespace pooled {
+// deque whose blocks are recycled through the pools of the calling thread
+template <class T, class BlockPolicy = sqrt_blocks>
+using deque = sjtu::deque<T, pool_allocator<T>, BlockPolicy>;
+}  // namespace pooled
+
+#if SJTU_DEQUE_PMR
+namespace pmr {
+// deque whose storage comes from a std::pmr::memory_resource
+template <class T, class BlockPolicy = sqrt_blocks>
+using deque =
+    sjtu::deque<T, std::pmr::polymorphic_allocator<T>, BlockPolicy>;
+}  // namespace pmr
+#endif
+
 }  // namespace sjtu
-#endif
\ No newline at end of file
+#endif
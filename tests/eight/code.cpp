@@ -0,0 +1,436 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <string>
+#include "deque.hpp"
+
+/***************************/
+int N = 100000;
+/***************************/
+
+// blocks of 64 that are never merged, a policy written by the user
+struct never_merge {
+    static constexpr size_t min_capacity(size_t) { return 64; }
+    static constexpr size_t max_capacity(size_t) { return 64; }
+    static size_t capacity(size_t, size_t) { return 64; }
+    static size_t limit(size_t capacity) { return capacity - 2; }
+    static size_t low(size_t, size_t) { return 0; }
+    static size_t merged(size_t n, size_t, size_t) { return n; }
+};
+
+// blocks of about sqrt(n) elements down to 8, so that a shrinking deque
+// has blocks worth compacting
+struct small_sqrt {
+    static constexpr size_t min_capacity(size_t) { return 8; }
+    static constexpr size_t max_capacity(size_t) { return 1 << 20; }
+    static size_t capacity(size_t, size_t total) {
+        return std::max<size_t>(8, sjtu::root_pow2(total));
+    }
+    static size_t limit(size_t capacity) { return capacity - 2; }
+    static size_t low(size_t, size_t total) {
+        return sjtu::root_pow2(total) / 2;
+    }
+    static size_t merged(size_t n, size_t, size_t) {
+        return std::max<size_t>(8, n * 2);
+    }
+};
+
+// bytes handed out by Tally and not returned, and allocate calls
+long live = 0, calls = 0;
+
+template <class T>
+struct Tally {
+    typedef T value_type;
+    Tally() {}
+    template <class U>
+    Tally(const Tally<U> &) {}
+    T *allocate(std::size_t n) {
+        live += n * sizeof(T);
+        calls++;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, std::size_t n) {
+        live -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+template <class T, class U>
+bool operator==(const Tally<T> &, const Tally<U> &) {
+    return true;
+}
+template <class T, class U>
+bool operator!=(const Tally<T> &, const Tally<U> &) {
+    return false;
+}
+
+template <class Q, class S>
+bool same(const Q &q, const S &stl) {
+    if (q.size() != stl.size()) return false;
+    for (int i = 0; i < (int)stl.size(); i++) {
+        if (q[i] != stl[i]) return false;
+    }
+    return true;
+}
+
+// the same mix of operations on q and stl
+template <class Q, class V>
+bool mixed(Q &q, std::deque<V> &stl, V (*make)(int)) {
+    for (int i = 0; i < N; i++) {
+        V v = make(rand());
+        int op = rand() % 6;
+        if (op == 0) q.push_back(v), stl.push_back(v);
+        else if (op == 1) q.push_front(v), stl.push_front(v);
+        else if (op == 2) {
+            int pos = rand() % (stl.size() + 1);
+            q.insert(q.begin() + pos, v), stl.insert(stl.begin() + pos, v);
+        } else if (op == 3 && !stl.empty()) {
+            int pos = rand() % stl.size();
+            q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+        } else if (op == 4 && !stl.empty()) {
+            int pos = rand() % stl.size();
+            if (q[pos] != stl[pos]) return false;
+        } else if (op == 5 && i % 100 == 0) {
+            int pos = rand() % (stl.size() + 1);
+            int len = rand() % (stl.size() - pos + 1);
+            q.erase(q.begin() + pos, q.begin() + pos + len);
+            stl.erase(stl.begin() + pos, stl.begin() + pos + len);
+        }
+    }
+    return same(q, stl);
+}
+
+// a large element, a kilobyte
+struct Big {
+    char bytes[1024];
+};
+
+int make_int(int x) { return x; }
+std::string make_string(int x) { return std::to_string(x); }
+
+void test1() {
+    printf("test1: fixed blocks                  ");
+    sjtu::deque<int, std::allocator<int>, sjtu::fixed_blocks<16> > q;
+    std::deque<int> stl;
+    if (!mixed(q, stl, make_int)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test2() {
+    printf("test2: byte blocks                   ");
+    typedef sjtu::deque<std::string, std::allocator<std::string>,
+                        sjtu::byte_blocks<1024> >
+        Deque;
+    Deque q;
+    std::deque<std::string> stl;
+    if (!mixed(q, stl, make_string)) {
+        puts("Wrong Answer");
+        return;
+    }
+    Deque r = q.split_at(q.begin() + q.size() / 2);
+    q.append(std::move(r));
+    Deque copy(q);
+    if (!same(q, stl) || !same(copy, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test3() {
+    printf("test3: user policy                   ");
+    sjtu::deque<int, std::allocator<int>, never_merge> q;
+    std::deque<int> stl;
+    if (!mixed(q, stl, make_int)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test4() {
+    printf("test4: block geometry                ");
+    typedef sjtu::deque<char> Chars;
+    typedef sjtu::deque<Big> Bigs;
+    typedef sjtu::deque<int, std::allocator<int>, sjtu::byte_blocks<32768> >
+        Ints;
+    // known at compile time
+    static_assert(Chars::min_block_capacity() == 4096, "");
+    static_assert(Bigs::min_block_capacity() == 8, "");
+    static_assert(Bigs::max_block_capacity() == 2048, "");
+    static_assert(Ints::max_block_capacity() == 8192, "");
+    Bigs q;
+    for (int i = 0; i < N / 10; i++) q.push_back(Big());
+    // about sqrt(n) elements
+    if (q.next_block_capacity() != 128 || (int)q.block_count() < N / 10 / 128) {
+        puts("Wrong Answer");
+        return;
+    }
+    Ints r;
+    for (int i = 0; i < N; i++) r.push_back(i);
+    if (r.next_block_capacity() != 8192 || (int)r.block_count() > N / 4096) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test5() {
+    printf("test5: memory reclamation            ");
+    int n = N / 4;
+    {
+        sjtu::deque<int, Tally<int>, small_sqrt> q;
+        std::deque<int> stl;
+        for (int i = 0; i < n; i++) {
+            int pos = rand() % (stl.size() + 1);
+            q.insert(q.begin() + pos, i), stl.insert(stl.begin() + pos, i);
+        }
+        long peak = live;
+        while ((int)stl.size() > n / 100) {
+            int pos = rand() % stl.size();
+            q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+        }
+        // sparse blocks and the directory were given back on the way
+        long erased = live;
+        if (erased * 10 > peak || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        q.shrink_to_fit();
+        if (live >= erased || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        q.push_front(-1), stl.push_front(-1);
+        q.insert(q.begin() + stl.size() / 2, -2);
+        stl.insert(stl.begin() + stl.size() / 2, -2);
+        if (!same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        q.clear();
+        q.shrink_to_fit();
+    }
+    if (live != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test6() {
+    printf("test6: reserve                       ");
+    {
+        sjtu::deque<int, Tally<int> > q;
+        std::deque<int> stl;
+        q.reserve_back(N);
+        q.reserve_front(N / 2);
+        long before = calls;
+        for (int i = 0; i < N; i++) q.push_back(i), stl.push_back(i);
+        for (int i = 0; i < N / 2; i++) q.push_front(-i), stl.push_front(-i);
+        if (calls != before || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        // a queue going round and round its reservation
+        q.clear(), stl.clear();
+        q.reserve_back(N / 10);
+        for (int i = 0; i < N / 10; i++) q.push_back(i), stl.push_back(i);
+        before = calls;
+        for (int i = 0; i < 10 * N; i++) {
+            q.push_back(i), stl.push_back(i);
+            q.pop_front(), stl.pop_front();
+        }
+        if (calls != before || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        q.shrink_to_fit();
+        if (!same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (live != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test7() {
+    printf("test7: no split/merge thrashing      ");
+    {
+        sjtu::deque<int, Tally<int>, sjtu::fixed_blocks<64> > q;
+        std::deque<int> stl;
+        for (int i = 0; i < N / 10; i++) q.push_back(i), stl.push_back(i);
+        // insert into a full block, then keep erasing and inserting there
+        int pos = N / 20;
+        long before = calls;
+        for (int i = 0; i < N; i++) {
+            if (i % 2 == 0) {
+                q.insert(q.begin() + pos, i), stl.insert(stl.begin() + pos, i);
+            } else {
+                q.erase(q.begin() + pos + 1), stl.erase(stl.begin() + pos + 1);
+            }
+        }
+        if (calls - before > 4 || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        // erase a run and insert it back, block by block
+        before = calls;
+        for (int i = 0; i < 100; i++) {
+            for (int j = 0; j < 48; j++) {
+                q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+            }
+            for (int j = 0; j < 48; j++) {
+                q.insert(q.begin() + pos, j), stl.insert(stl.begin() + pos, j);
+            }
+        }
+        if (calls - before > 300 || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (live != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test8() {
+    printf("test8: inserts at the ends           ");
+    sjtu::deque<int, std::allocator<int>, sjtu::fixed_blocks<64> > q;
+    std::deque<int> stl;
+    int n = N / 10;
+    for (int i = 0; i < n; i++) {
+        auto it = i % 2 ? q.insert(q.end(), i) : q.insert(q.begin(), i);
+        if (*it != i || it - q.begin() != (i % 2 ? (int)q.size() - 1 : 0)) {
+            puts("Wrong Answer");
+            return;
+        }
+        if (i % 2) stl.push_back(i);
+        else stl.push_front(i);
+    }
+    // blocks at the ends are filled up, not split in halves
+    if ((int)q.block_count() > n / 63 + 2 || !same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test9() {
+    printf("test9: spare blocks                  ");
+    {
+        sjtu::deque<int, Tally<int> > q;
+        std::deque<int> stl;
+        for (int i = 0; i < N / 10; i++) q.push_back(i), stl.push_back(i);
+        // a queue with no reservation: warm up, then no allocations
+        for (int i = 0; i < N; i++) {
+            q.push_back(i), stl.push_back(i);
+            q.pop_front(), stl.pop_front();
+        }
+        long before = calls;
+        for (int i = 0; i < 10 * N; i++) {
+            q.push_back(i), stl.push_back(i);
+            q.pop_front(), stl.pop_front();
+        }
+        if (calls != before || q.spare_blocks() != sjtu::SPARE_BLOCKS ||
+            !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        q.set_spare_blocks(0);
+        for (int i = 0; i < 10 * N; i++) {
+            q.push_front(i), stl.push_front(i);
+            q.pop_back(), stl.pop_back();
+        }
+        if (calls == before || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        // shrink_to_fit() frees the kept blocks, keeping the setting
+        q.set_spare_blocks(1);
+        for (int k = 0; k < 2; k++) {
+            for (int i = 0; i < N; i++) q.push_back(i), stl.push_back(i);
+            for (int i = 0; i < N; i++) q.pop_back(), stl.pop_back();
+            if (k == 0) q.clear(), stl.clear();
+            q.shrink_to_fit();
+            before = calls;
+            for (size_t i = 0; i < q.next_block_capacity(); i++) {
+                q.push_back(i), stl.push_back(i);
+            }
+            if (calls == before || q.spare_blocks() != 1 || !same(q, stl)) {
+                puts("Wrong Answer");
+                return;
+            }
+        }
+    }
+    if (live != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test10() {
+    printf("test10: directory moves              ");
+    // small blocks, so the directory moves often, mostly while the ends
+    // keep changing and the deque is read
+    sjtu::deque<int, std::allocator<int>, sjtu::fixed_blocks<8> > q;
+    std::deque<int> stl;
+    for (int i = 0; i < 20 * N; i++) {
+        // growing and shrinking by turns, so the directory does both
+        int push = (i / N) % 2 == 0 ? 55 : 43;
+        int op = rand() % 100;
+        if (op < push / 2) {
+            q.push_back(i), stl.push_back(i);
+        } else if (op < push) {
+            q.push_front(i), stl.push_front(i);
+        } else if (op < (push + 98) / 2 && !stl.empty()) {
+            q.pop_back(), stl.pop_back();
+        } else if (op < 98 && !stl.empty()) {
+            q.pop_front(), stl.pop_front();
+        } else if (op < 99) {
+            int pos = stl.empty() ? 0 : rand() % stl.size();
+            q.insert(q.begin() + pos, i), stl.insert(stl.begin() + pos, i);
+        } else if (!stl.empty()) {
+            int pos = rand() % stl.size();
+            q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+        }
+        if (!stl.empty()) {
+            int pos = rand() % stl.size();
+            if (q[pos] != stl[pos] || q.front() != stl.front() ||
+                q.back() != stl.back()) {
+                puts("Wrong Answer");
+                return;
+            }
+        }
+    }
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+int main() {
+    srand(time(NULL));
+    puts("test start:");
+    test1();  // fixed blocks
+    test2();  // byte blocks
+    test3();  // user policy
+    test4();  // block geometry
+    test5();  // memory reclamation
+    test6();  // reserve
+    test7();  // no split/merge thrashing
+    test8();  // inserts at the ends
+    test9();  // spare blocks
+    test10();  // directory moves
+}
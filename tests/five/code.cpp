@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <string>
+#include "deque.hpp"
+
+/***************************/
+int N = 20000;
+/***************************/
+
+// move-only element, counts live objects
+class Token {
+   public:
+    static int alive;
+    std::unique_ptr<int> p;
+    explicit Token(int x) : p(new int(x)) { ++alive; }
+    Token(int x, int y) : p(new int(x * y)) { ++alive; }
+    Token(Token &&other) : p(std::move(other.p)) { ++alive; }
+    Token &operator=(Token &&other) {
+        p = std::move(other.p);
+        return *this;
+    }
+    ~Token() { --alive; }
+    int num() const { return p ? *p : -1; }
+};
+int Token::alive = 0;
+
+void test1() {
+    printf("test1: move-only push & emplace      ");
+    {
+        sjtu::deque<Token> q;
+        std::deque<int> stl;
+        for (int i = 0; i < N; i++) {
+            if (i % 4 == 0) q.push_back(Token(i)), stl.push_back(i);
+            else if (i % 4 == 1) q.push_front(Token(i)), stl.push_front(i);
+            else if (i % 4 == 2) q.emplace_back(i, 2), stl.push_back(i * 2);
+            else q.emplace_front(i, 3), stl.push_front(i * 3);
+        }
+        for (int i = 0; i < N; i++) {
+            if (q[i].num() != stl[i]) {
+                puts("Wrong Answer");
+                return;
+            }
+        }
+        if (q.emplace_back(7).num() != 7 || q.emplace_front(8).num() != 8) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (Token::alive != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test2() {
+    printf("test2: emplace & insert rvalue       ");
+    sjtu::deque<Token> q;
+    std::deque<int> stl;
+    for (int i = 0; i < N; i++) {
+        int pos = rand() % (stl.size() + 1);
+        sjtu::deque<Token>::iterator it;
+        if (i % 2) {
+            it = q.emplace(q.begin() + pos, i);
+        } else {
+            it = q.insert(q.begin() + pos, Token(i));
+        }
+        stl.insert(stl.begin() + pos, i);
+        if (it - q.begin() != pos || it->num() != i) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    for (int i = 0; i < N / 2; i++) {
+        int pos = rand() % stl.size();
+        q.erase(q.begin() + pos);
+        stl.erase(stl.begin() + pos);
+    }
+    for (int i = 0; i < (int)stl.size(); i++) {
+        if (q[i].num() != stl[i]) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    puts("Accept");
+}
+
+void test3() {
+    printf("test3: insert element of itself      ");
+    sjtu::deque<std::string> q;
+    std::deque<std::string> stl;
+    for (int i = 0; i < N; i++) {
+        std::string s = std::to_string(i);
+        q.push_back(s), stl.push_back(s);
+    }
+    for (int i = 0; i < N; i++) {
+        int pos = rand() % stl.size();
+        q.push_back(q[pos]), stl.push_back(stl[pos]);
+        q.push_front(q[pos]), stl.push_front(stl[pos]);
+        q.insert(q.begin() + pos / 2, q[pos]);
+        stl.insert(stl.begin() + pos / 2, stl[pos]);
+    }
+    for (int i = 0; i < (int)stl.size(); i++) {
+        if (q[i] != stl[i]) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    puts("Accept");
+}
+
+sjtu::deque<std::string> make(int n) {
+    sjtu::deque<std::string> q;
+    for (int i = 0; i < n; i++) q.push_back(std::to_string(i));
+    return q;
+}
+
+void test4() {
+    printf("test4: move & swap                   ");
+    sjtu::deque<std::string> a = make(N);
+    sjtu::deque<std::string>::iterator it = a.begin() + N / 2;
+    sjtu::deque<std::string> b(std::move(a));
+    if ((int)b.size() != N || *it != std::to_string(N / 2) ||
+        b.begin() + N / 2 != it) {
+        puts("Wrong Answer");
+        return;
+    }
+    a.clear();
+    a.push_back("x");
+    b = std::move(a);
+    if (b.size() != 1 || b.front() != "x") {
+        puts("Wrong Answer");
+        return;
+    }
+    a = make(10);
+    swap(a, b);
+    if (a.size() != 1 || b.size() != 10 || b.back() != "9") {
+        puts("Wrong Answer");
+        return;
+    }
+    a.swap(b);
+    std::swap(a, b);
+    if (a.size() != 1 || b.size() != 10 || a.front() != "x") {
+        puts("Wrong Answer");
+        return;
+    }
+    sjtu::deque<Token> c;
+    c.emplace_back(1);
+    sjtu::deque<Token> d(std::move(c));
+    c = std::move(d);
+    if (c.size() != 1 || c[0].num() != 1) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test5() {
+    printf("test5: use after move                ");
+    sjtu::deque<std::string> a = make(N);
+    sjtu::deque<std::string> b(std::move(a));
+    int seen = 0;
+    for (const std::string &s : a) seen += s.size();
+    const sjtu::deque<std::string> &ca = a;
+    if (seen != 0 || a.begin() != a.end() || ca.cbegin() != ca.cend() ||
+        !a.empty()) {
+        puts("Wrong Answer");
+        return;
+    }
+    a.push_back("1");
+    a.push_front("0");
+    a.insert(a.begin() + 1, "x");
+    a.emplace_back("2");
+    if (a.size() != 4 || a[0] != "0" || a[1] != "x" || a.back() != "2") {
+        puts("Wrong Answer");
+        return;
+    }
+    sjtu::deque<std::string> c;
+    c = std::move(b);
+    b.insert(b.end(), c.begin(), c.begin() + 3);
+    b.emplace_front("y");
+    if (b.size() != 4 || b.front() != "y" || b[3] != "2" ||
+        (int)c.size() != N) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+int main() {
+    srand(time(NULL));
+    puts("test start:");
+    test1();  // move-only push & emplace
+    test2();  // emplace & insert rvalue
+    test3();  // insert element of itself
+    test4();  // move & swap
+    test5();  // use after move
+}
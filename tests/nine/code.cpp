@@ -0,0 +1,304 @@
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "deque.hpp"
+
+/***************************/
+int N = 100000;
+/***************************/
+
+// the same mix of pushes, inserts and erases on q and stl, so that
+// blocks wrap around at random points
+template <class Q, class V>
+void mixed(Q &q, std::deque<V> &stl, V (*make)(int)) {
+    for (int i = 0; i < N; i++) {
+        V v = make(rand());
+        int op = rand() % 6;
+        if (op == 0) q.push_back(v), stl.push_back(v);
+        else if (op == 1 || op == 2) q.push_front(v), stl.push_front(v);
+        else if (op == 3) {
+            int pos = rand() % (stl.size() + 1);
+            q.insert(q.begin() + pos, v), stl.insert(stl.begin() + pos, v);
+        } else if (op == 4 && !stl.empty()) {
+            int pos = rand() % stl.size();
+            q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+        } else if (op == 5 && !stl.empty()) {
+            q.pop_back(), stl.pop_back();
+        }
+    }
+}
+
+int make_int(int x) { return x; }
+std::string make_string(int x) { return std::to_string(x); }
+
+// the spans of q, read one after another, are stl
+template <class Q, class V>
+bool covers(const Q &q, const std::deque<V> &stl) {
+    size_t k = 0;
+    for (auto s : q.segments()) {
+        if (s.empty() || k + s.size() > stl.size()) return false;
+        for (size_t i = 0; i < s.size(); i++) {
+            if (s[i] != stl[k + i] || &s[i] != &q[k + i]) return false;
+        }
+        k += s.size();
+    }
+    return k == stl.size();
+}
+
+void test1() {
+    printf("test1: segments                      ");
+    sjtu::deque<int> q;
+    std::deque<int> stl;
+    mixed(q, stl, make_int);
+    sjtu::deque<std::string, std::allocator<std::string>,
+                sjtu::fixed_blocks<8> >
+        r;
+    std::deque<std::string> strs;
+    mixed(r, strs, make_string);
+    if (!covers(q, stl) || !covers(r, strs)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test2() {
+    printf("test2: for each segment              ");
+    sjtu::deque<int, std::allocator<int>, sjtu::fixed_blocks<16> > q;
+    std::deque<int> stl;
+    mixed(q, stl, make_int);
+    q.for_each_segment([](sjtu::span<int> s) {
+        for (int &x : s) x = x / 2 + 1;
+    });
+    long long sum = 0, want = 0;
+    const auto &cq = q;
+    cq.for_each_segment([&sum](sjtu::span<const int> s) {
+        for (size_t i = 0; i < s.size(); i++) sum += s.data()[i];
+    });
+    for (size_t i = 0; i < stl.size(); i++) {
+        want += stl[i] / 2 + 1;
+        if (q[i] != stl[i] / 2 + 1) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (sum != want) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test3() {
+    printf("test3: empty segments                ");
+    sjtu::deque<int> q;
+    int n = 0;
+    q.for_each_segment([&n](sjtu::span<int>) { n++; });
+    for (int i = 0; i < 1000; i++) q.push_front(i);
+    while (!q.empty()) q.pop_back();
+    q.for_each_segment([&n](sjtu::span<int>) { n++; });
+    q.push_back(1);
+    sjtu::deque<int> moved(std::move(q));
+    q.for_each_segment([&n](sjtu::span<int>) { n++; });
+    if (n != 0 || q.segments().begin() != q.segments().end()) {
+        puts("Wrong Answer");
+        return;
+    }
+    moved.for_each_segment([&n](sjtu::span<int> s) { n += s.size(); });
+    if (n != 1) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test4() {
+    printf("test4: algorithms                    ");
+    sjtu::deque<int> q;
+    std::deque<int> stl;
+    mixed(q, stl, make_int);
+    for (int i = 0; i < (int)stl.size(); i++) q[i] %= 10, stl[i] %= 10;
+    for (int t = 0; t < 100; t++) {
+        int l = rand() % (stl.size() + 1), r = rand() % (stl.size() + 1);
+        if (l > r) std::swap(l, r);
+        auto qb = q.begin() + l, qe = q.begin() + r;
+        auto sb = stl.begin() + l, se = stl.begin() + r;
+        int v = rand() % 10;
+        long long sum = 0;
+        sjtu::for_each(qb, qe, [&sum](int x) { sum += x; });
+        if (sum != sjtu::accumulate(qb, qe, 0LL) ||
+            sum != std::accumulate(sb, se, 0LL) ||
+            sjtu::reduce(qb, qe) != std::accumulate(sb, se, 0) ||
+            sjtu::find(qb, qe, v) - q.begin() != std::find(sb, se, v) -
+                                                     stl.begin() ||
+            sjtu::count(qb, qe, v) != std::count(sb, se, v) ||
+            sjtu::count_if(qb, qe, [](int x) { return x < 5; }) !=
+                std::count_if(sb, se, [](int x) { return x < 5; })) {
+            puts("Wrong Answer");
+            return;
+        }
+        std::vector<int> out(r - l);
+        sjtu::copy(qb, qe, out.data());
+        if (!std::equal(out.begin(), out.end(), sb) ||
+            !sjtu::equal(qb, qe, out.begin()) ||
+            !sjtu::equal(qb, qe, q.cbegin() + l)) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    sjtu::fill(q.begin() + 10, q.end() - 10, 0);
+    std::fill(stl.begin() + 10, stl.end() - 10, 0);
+    sjtu::fill(q.begin(), q.begin() + 5, 7);
+    std::fill(stl.begin(), stl.begin() + 5, 7);
+    if (!sjtu::equal(q.begin(), q.end(), stl.begin()) ||
+        sjtu::equal(q.begin(), q.end(), stl.rbegin())) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test5() {
+    printf("test5: copy between deques           ");
+    sjtu::deque<std::string> q;
+    std::deque<std::string> stl;
+    mixed(q, stl, make_string);
+    sjtu::deque<std::string, std::allocator<std::string>,
+                sjtu::fixed_blocks<8> >
+        r;
+    r.assign(stl.size() / 2, "");
+    const sjtu::deque<std::string> &cq = q;
+    auto e = sjtu::copy_n(cq.cbegin() + 3, r.size(), r.begin());
+    if (e != r.end() || !sjtu::equal(r.begin(), r.end(), stl.begin() + 3) ||
+        sjtu::find(cq.cbegin(), cq.cend(), "x") != cq.cend()) {
+        puts("Wrong Answer");
+        return;
+    }
+    sjtu::deque<int> a, b;
+    for (int i = 0; i < N; i++) a.push_front(i), b.push_back(0);
+    sjtu::copy(a.begin() + 1, a.end(), b.begin());
+    if (b[0] != N - 2 || b[N - 2] != 0 || b[N - 1] != 0 ||
+        !sjtu::equal(b.begin(), b.end() - 1, a.begin() + 1)) {
+        puts("Wrong Answer");
+        return;
+    }
+    // to the left in place, across blocks
+    std::deque<int> sa(a.begin(), a.end());
+    auto ae = sjtu::copy(a.begin() + 1, a.end(), a.begin());
+    std::copy(sa.begin() + 1, sa.end(), sa.begin());
+    sjtu::copy(q.begin() + 5, q.end(), q.begin());
+    std::copy(stl.begin() + 5, stl.end(), stl.begin());
+    if (ae != a.end() - 1 || !sjtu::equal(a.begin(), a.end(), sa.begin()) ||
+        !sjtu::equal(q.begin(), q.end(), stl.begin())) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+// find, count, min, max, sum and equal on q against std on stl; values
+// are few, so that there is something to find and count
+template <class V>
+bool kernels(int few) {
+    sjtu::deque<V> q;
+    std::deque<V> stl;
+    for (int i = 0; i < N; i++) {
+        V v = V(rand() % few) / 2 - V(few / 5);
+        if (rand() % 3) q.push_back(v), stl.push_back(v);
+        else q.push_front(v), stl.push_front(v);
+    }
+    for (int t = 0; t < 50; t++) {
+        int l = rand() % (stl.size() + 1), r = rand() % (stl.size() + 1);
+        if (l > r) std::swap(l, r);
+        auto qb = q.begin() + l, qe = q.begin() + r;
+        auto sb = stl.begin() + l, se = stl.begin() + r;
+        V v = V(rand() % few) / 2 - V(few / 5);
+        if (sjtu::find(qb, qe, v) - q.begin() !=
+                std::find(sb, se, v) - stl.begin() ||
+            sjtu::count(qb, qe, v) != std::count(sb, se, v) ||
+            sjtu::min_element(qb, qe) - q.begin() !=
+                std::min_element(sb, se) - stl.begin() ||
+            sjtu::max_element(qb, qe) - q.begin() !=
+                std::max_element(sb, se) - stl.begin() ||
+            sjtu::reduce(qb, qe, V(0)) != std::accumulate(sb, se, V(0))) {
+            return false;
+        }
+        std::vector<V> out(sb, se);
+        if (!sjtu::equal(qb, qe, out.data()) || r - l < 2) continue;
+        out[rand() % (r - l)] += 1;
+        if (sjtu::equal(qb, qe, out.data()) ||
+            !sjtu::equal(qb + 1, qe, q.cbegin() + l + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test6() {
+    printf("test6: simd kernels                  ");
+    // the sums of halves and small integers are exact in float and double
+    if (!kernels<int>(1000) || !kernels<long long>(1000) ||
+        !kernels<long>(10) || !kernels<float>(100) ||
+        !kernels<double>(1000)) {
+        puts("Wrong Answer");
+        return;
+    }
+    sjtu::deque<double> q;
+    std::deque<double> stl;
+    for (int i = 0; i < 1000; i++) {
+        double v = i % 7 == 3 ? std::nan("") : i % 5 - 2.0;
+        if (i == 500) v = -0.0;
+        q.push_front(v), stl.push_front(v);
+    }
+    auto qb = q.begin() + 1;
+    auto sb = stl.begin() + 1;
+    if (sjtu::min_element(qb, q.end()) - q.begin() !=
+            std::min_element(sb, stl.end()) - stl.begin() ||
+        sjtu::max_element(qb, q.end()) - q.begin() !=
+            std::max_element(sb, stl.end()) - stl.begin() ||
+        sjtu::find(q.begin(), q.end(), std::nan("")) != q.end() ||
+        sjtu::count(q.begin(), q.end(), 0.0) !=
+            std::count(stl.begin(), stl.end(), 0.0) ||
+        sjtu::equal(q.begin(), q.end(), stl.begin())) {
+        puts("Wrong Answer");
+        return;
+    }
+    // blocks of 7 that start with a NaN, after the first one
+    sjtu::deque<double, std::allocator<double>, sjtu::fixed_blocks<8> > r;
+    std::deque<double> sr;
+    for (int i = 0; i < 200; i++) {
+        double v = i % 7 == 0 ? std::nan("") : i * 37 % 101 - 50.0;
+        if (i < 9) v = i == 7 ? std::nan("") : i == 8 ? -7.0 : i + 5.0;
+        r.push_back(v), sr.push_back(v);
+    }
+    for (int from = 0; from < 20; from++) {
+        for (int to = from; to <= 200; to += 9) {
+            auto rb = r.begin() + from, re = r.begin() + to;
+            auto sb = sr.begin() + from, se = sr.begin() + to;
+            if (sjtu::min_element(rb, re) - r.begin() !=
+                    std::min_element(sb, se) - sr.begin() ||
+                sjtu::max_element(rb, re) - r.begin() !=
+                    std::max_element(sb, se) - sr.begin()) {
+                puts("Wrong Answer");
+                return;
+            }
+        }
+    }
+    puts("Accept");
+}
+
+int main() {
+    srand(time(NULL));
+    puts("test start:");
+    test1();  // segments
+    test2();  // for each segment
+    test3();  // empty segments
+    test4();  // algorithms
+    test5();  // copy between deques
+    test6();  // simd kernels
+}
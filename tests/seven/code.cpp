@@ -0,0 +1,272 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "deque.hpp"
+
+/***************************/
+int N = 20000;
+/***************************/
+
+// bookkeeping of one arena
+struct Arena {
+    long live = 0;   // bytes handed out and not returned
+    long calls = 0;  // number of allocate calls
+};
+
+// stateful allocator drawing from an Arena, not propagated on assignment
+template <class T>
+struct Counted {
+    typedef T value_type;
+    Arena *arena;
+    explicit Counted(Arena *arena) : arena(arena) {}
+    template <class U>
+    Counted(const Counted<U> &other) : arena(other.arena) {}
+    T *allocate(std::size_t n) {
+        arena->live += n * sizeof(T);
+        arena->calls++;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T *p, std::size_t n) {
+        arena->live -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+template <class T, class U>
+bool operator==(const Counted<T> &a, const Counted<U> &b) {
+    return a.arena == b.arena;
+}
+template <class T, class U>
+bool operator!=(const Counted<T> &a, const Counted<U> &b) {
+    return a.arena != b.arena;
+}
+
+#if SJTU_DEQUE_PMR
+// memory resource counting the calls that reach it
+struct Upstream : std::pmr::memory_resource {
+    long calls = 0;
+    void *do_allocate(std::size_t bytes, std::size_t align) override {
+        calls++;
+        return std::pmr::new_delete_resource()->allocate(bytes, align);
+    }
+    void do_deallocate(void *p, std::size_t bytes,
+                       std::size_t align) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const
+        noexcept override {
+        return this == &other;
+    }
+};
+#endif
+
+typedef sjtu::deque<std::string, Counted<std::string> > Deque;
+
+template <class Q>
+bool same(const Q &q, const std::deque<std::string> &stl) {
+    if (q.size() != stl.size()) return false;
+    for (int i = 0; i < (int)stl.size(); i++) {
+        if (q[i] != stl[i]) return false;
+    }
+    return true;
+}
+
+void test1() {
+    printf("test1: every allocation from arena   ");
+    Arena arena;
+    {
+        Deque q{Counted<std::string>(&arena)};
+        std::deque<std::string> stl;
+        for (int i = 0; i < N; i++) {
+            std::string s = std::to_string(i);
+            if (i % 3 == 0) q.push_back(s), stl.push_back(s);
+            else if (i % 3 == 1) q.push_front(s), stl.push_front(s);
+            else {
+                int pos = rand() % (stl.size() + 1);
+                q.insert(q.begin() + pos, s), stl.insert(stl.begin() + pos, s);
+            }
+        }
+        for (int i = 0; i < N / 2; i++) {
+            int pos = rand() % stl.size();
+            q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+        }
+        Deque copy(q);
+        if (!same(copy, stl) || copy.get_allocator() != q.get_allocator()) {
+            puts("Wrong Answer");
+            return;
+        }
+        if (arena.live <= 0 || !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (arena.live != 0 || arena.calls == 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test2() {
+    printf("test2: deques on different arenas    ");
+    Arena a1, a2;
+    {
+        Deque p{Counted<std::string>(&a1)}, q{Counted<std::string>(&a2)};
+        std::deque<std::string> sp, sq;
+        for (int i = 0; i < N; i++) {
+            p.push_back(std::to_string(i)), sp.push_back(std::to_string(i));
+            q.push_front(std::to_string(-i)), sq.push_front(std::to_string(-i));
+        }
+        // other arena: the elements move, the blocks stay
+        p.splice(p.begin() + N / 2, std::move(q));
+        sp.insert(sp.begin() + N / 2, sq.begin(), sq.end());
+        if (!q.empty() || !same(p, sp)) {
+            puts("Wrong Answer");
+            return;
+        }
+        // same arena: the blocks move
+        Deque r = p.split_at(p.begin() + N);
+        p.prepend(std::move(r));
+        std::deque<std::string> tail(sp.begin() + N, sp.end());
+        sp.erase(sp.begin() + N, sp.end());
+        sp.insert(sp.begin(), tail.begin(), tail.end());
+        if (!same(p, sp) || p.get_allocator().arena != &a1) {
+            puts("Wrong Answer");
+            return;
+        }
+        // assignments keep the arena of the target
+        q = p;
+        if (!same(q, sp) || q.get_allocator().arena != &a2) {
+            puts("Wrong Answer");
+            return;
+        }
+        q.clear();
+        q = std::move(p);
+        if (!same(q, sp) || q.get_allocator().arena != &a2) {
+            puts("Wrong Answer");
+            return;
+        }
+        p.clear();
+        p.push_back("x");
+        if (p.size() != 1 || p.get_allocator().arena != &a1) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (a1.live != 0 || a2.live != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test3() {
+    printf("test3: blocks recycled through pool  ");
+    typedef sjtu::pooled::deque<std::string> Pooled;
+    typedef sjtu::pool_allocator<std::string> Pool;
+    Pool::trim();
+    for (int round = 0; round < 3; round++) {
+        sjtu::pool_stats before = Pool::stats();
+        {
+            std::vector<Pooled> qs(100);
+            std::vector<std::deque<std::string> > stl(100);
+            for (int i = 0; i < N * 5; i++) {
+                int k = rand() % 100;
+                std::string s = std::to_string(i);
+                if (i % 5 < 2) qs[k].push_back(s), stl[k].push_back(s);
+                else if (i % 5 < 4) qs[k].push_front(s), stl[k].push_front(s);
+                else if (!stl[k].empty()) qs[k].pop_back(), stl[k].pop_back();
+            }
+            // equal allocators: the blocks move
+            qs[0].append(std::move(qs[1]));
+            stl[0].insert(stl[0].end(), stl[1].begin(), stl[1].end());
+            stl[1].clear();
+            for (int k = 0; k < 100; k++) {
+                if (!same(qs[k], stl[k])) {
+                    puts("Wrong Answer");
+                    return;
+                }
+            }
+        }
+        // later rounds build their blocks from the ones freed before
+        sjtu::pool_stats after = Pool::stats();
+        if (after.cached == 0 || (round > 0 && after.reused == before.reused)) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    // the directories are pooled too, and trimmed with the blocks
+    typedef sjtu::block_map<std::string, Pool> Map;
+    if (sjtu::block_pool<Map>::local()->stats().reused == 0 ||
+        Pool::trim() == 0 || Pool::stats().cached != 0 ||
+        Pool::stats().cached_bytes != 0 ||
+        sjtu::block_pool<Map>::local()->stats().cached != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test4() {
+    printf("test4: pmr deques on arenas          ");
+#if SJTU_DEQUE_PMR
+    typedef sjtu::pmr::deque<std::string> Pmr;
+    typedef std::pmr::polymorphic_allocator<std::string> Alloc;
+    std::vector<char> buf(size_t(8) << 20);
+    Upstream up1, up2;
+    std::pmr::monotonic_buffer_resource r1(buf.data(), buf.size(), &up1);
+    std::pmr::monotonic_buffer_resource r2(&up2);
+    Pmr p{Alloc(&r1)}, q{Alloc(&r2)};
+    std::deque<std::string> sp, sq;
+    for (int i = 0; i < N; i++) {
+        std::string s = std::to_string(i);
+        if (i % 2) p.push_back(s), sp.push_back(s);
+        else p.push_front(s), sp.push_front(s);
+        if (i % 3 == 0) {
+            int pos = rand() % (sp.size() + 1);
+            p.insert(p.begin() + pos, s), sp.insert(sp.begin() + pos, s);
+        }
+        if (i % 2) q.push_back(s), sq.push_back(s);
+    }
+    // the buffer is large enough: nothing reaches the upstream of r1
+    if (up1.calls != 0 || up2.calls == 0 || !same(p, sp) || !same(q, sq)) {
+        puts("Wrong Answer");
+        return;
+    }
+    // other resource: the elements move, each deque keeps its own
+    p.splice(p.begin() + N / 2, std::move(q));
+    sp.insert(sp.begin() + N / 2, sq.begin(), sq.end());
+    if (!q.empty() || !same(p, sp) ||
+        p.get_allocator().resource() != &r1) {
+        puts("Wrong Answer");
+        return;
+    }
+    q = p;
+    q.push_back("x"), sp.push_back("x");
+    p.assign(q.begin(), q.end());
+    if (!same(p, sp) || !same(q, sp) ||
+        q.get_allocator().resource() != &r2) {
+        puts("Wrong Answer");
+        return;
+    }
+    p = std::move(q);
+    if (!same(p, sp) || p.get_allocator().resource() != &r1 ||
+        up1.calls != 0) {
+        puts("Wrong Answer");
+        return;
+    }
+#endif
+    puts("Accept");
+}
+
+int main() {
+    srand(time(NULL));
+    puts("test start:");
+    test1();  // every allocation from arena
+    test2();  // deques on different arenas
+    test3();  // pooled deques sharing blocks
+    test4();  // pmr deques on monotonic arenas
+}
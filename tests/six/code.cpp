@@ -0,0 +1,247 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <list>
+#include <sstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "deque.hpp"
+
+/***************************/
+int N = 200000;
+/***************************/
+
+template <class Q, class S>
+bool same(const Q &q, const S &stl) {
+    if (q.size() != stl.size()) return false;
+    for (int i = 0; i < (int)stl.size(); i++) {
+        if (q[i] != stl[i]) return false;
+    }
+    return true;
+}
+
+void test1() {
+    printf("test1: insert ranges                 ");
+    sjtu::deque<int> q;
+    std::deque<int> stl;
+    std::vector<int> v;
+    std::list<int> l;
+    for (int i = 0; i < N / 10; i++) v.push_back(rand()), l.push_back(rand());
+    for (int i = 0; i < 50; i++) {
+        int pos = rand() % (stl.size() + 1);
+        int len = rand() % v.size();
+        sjtu::deque<int>::iterator it;
+        if (i % 3 == 0) {
+            // plain array
+            it = q.insert(q.begin() + pos, v.data(), v.data() + len);
+            stl.insert(stl.begin() + pos, v.begin(), v.begin() + len);
+        } else if (i % 3 == 1) {
+            it = q.insert(q.begin() + pos, l.begin(), l.end());
+            stl.insert(stl.begin() + pos, l.begin(), l.end());
+        } else {
+            // another deque
+            sjtu::deque<int> other;
+            for (int j = 0; j < len; j++) other.push_back(v[j]);
+            it = q.insert(q.begin() + pos, other.cbegin(), other.cend());
+            stl.insert(stl.begin() + pos, v.begin(), v.begin() + len);
+        }
+        if (it - q.begin() != pos) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    // single pass input
+    std::istringstream in("1 2 3 4 5");
+    q.insert(q.begin() + 1, std::istream_iterator<int>(in),
+             std::istream_iterator<int>());
+    for (int i = 1; i <= 5; i++) stl.insert(stl.begin() + i, i);
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test2() {
+    printf("test2: insert copies                 ");
+    sjtu::deque<std::string> q;
+    std::deque<std::string> stl;
+    for (int i = 0; i < 300; i++) {
+        int pos = rand() % (stl.size() + 1);
+        int n = rand() % 1000;
+        std::string s = std::to_string(i);
+        sjtu::deque<std::string>::iterator it = q.insert(q.begin() + pos, n, s);
+        if (n) stl.insert(stl.begin() + pos, n, s);
+        if (it - q.begin() != pos) {
+            puts("Wrong Answer");
+            return;
+        }
+        // the value may be an element of the deque itself
+        if (stl.empty()) continue;
+        pos = rand() % stl.size();
+        int from = rand() % stl.size();
+        q.insert(q.begin() + pos, 3, q[from]);
+        stl.insert(stl.begin() + pos, 3, stl[from]);
+    }
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test3() {
+    printf("test3: append & assign               ");
+    sjtu::deque<int> q;
+    std::deque<int> stl;
+    std::vector<int> v;
+    for (int i = 0; i < N; i++) v.push_back(i);
+    q.append(v.begin(), v.end());
+    q.push_front(-1), q.push_back(-2);
+    stl.insert(stl.end(), v.begin(), v.end());
+    stl.push_front(-1), stl.push_back(-2);
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    q.assign(v.rbegin(), v.rend());
+    stl.assign(v.rbegin(), v.rend());
+    for (int i = 0; i < N / 10; i++) {
+        int pos = rand() % stl.size();
+        q.erase(q.begin() + pos), stl.erase(stl.begin() + pos);
+        pos = rand() % (stl.size() + 1);
+        q.insert(q.begin() + pos, i), stl.insert(stl.begin() + pos, i);
+    }
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    q.assign(7, 42);
+    stl.assign(7, 42);
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    q.assign(v.begin(), v.begin());
+    if (!q.empty() || q.begin() != q.end()) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test4() {
+    printf("test4: erase ranges                  ");
+    sjtu::deque<int> q;
+    std::deque<int> stl;
+    for (int i = 0; i < N; i++) q.push_back(i), stl.push_back(i);
+    while (stl.size() > 1000) {
+        int pos = rand() % stl.size();
+        int len = rand() % 2 ? rand() % 50 : rand() % (stl.size() - pos + 1) / 4;
+        if (pos + len > (int)stl.size()) len = stl.size() - pos;
+        sjtu::deque<int>::iterator it =
+            q.erase(q.begin() + pos, q.begin() + pos + len);
+        std::deque<int>::iterator sit =
+            stl.erase(stl.begin() + pos, stl.begin() + pos + len);
+        if (it - q.begin() != pos || (sit != stl.end() && *it != *sit) ||
+            (sit == stl.end() && it != q.end())) {
+            puts("Wrong Answer");
+            return;
+        }
+        // window expiry: drop a prefix
+        len = rand() % 100;
+        if (len > (int)stl.size()) len = stl.size();
+        q.erase(q.begin(), q.begin() + len);
+        stl.erase(stl.begin(), stl.begin() + len);
+        q.push_back(-len), stl.push_back(-len);
+    }
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    q.erase(q.begin(), q.end());
+    if (!q.empty() || q.begin() != q.end()) {
+        puts("Wrong Answer");
+        return;
+    }
+    q.push_front(1);
+    if (q.size() != 1 || q.front() != 1) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+void test5() {
+    printf("test5: split & splice                ");
+    sjtu::deque<std::string> q;
+    std::deque<std::string> stl;
+    for (int i = 0; i < N / 10; i++) {
+        q.push_back(std::to_string(i));
+        stl.push_back(std::to_string(i));
+    }
+    for (int i = 0; i < 1000; i++) {
+        int pos = rand() % (stl.size() + 1);
+        sjtu::deque<std::string> part = q.split_at(q.begin() + pos);
+        std::deque<std::string> spart(stl.begin() + pos, stl.end());
+        stl.erase(stl.begin() + pos, stl.end());
+        if (i % 100 == 0 && !same(q, stl)) {
+            puts("Wrong Answer");
+            return;
+        }
+        part.push_front("f"), spart.push_front("f");
+        if (i % 3 == 0) {
+            q.prepend(std::move(part));
+            stl.insert(stl.begin(), spart.begin(), spart.end());
+        } else if (i % 3 == 1) {
+            q.append(std::move(part));
+            stl.insert(stl.end(), spart.begin(), spart.end());
+        } else {
+            pos = rand() % (stl.size() + 1);
+            sjtu::deque<std::string>::iterator it =
+                q.splice(q.begin() + pos, std::move(part));
+            stl.insert(stl.begin() + pos, spart.begin(), spart.end());
+            if (it - q.begin() != pos || *it != "f") {
+                puts("Wrong Answer");
+                return;
+            }
+        }
+        if (!part.empty()) {
+            puts("Wrong Answer");
+            return;
+        }
+    }
+    if (!same(q, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    sjtu::deque<std::string> all = q.split_at(q.begin());
+    if (!q.empty() || all.size() != stl.size()) {
+        puts("Wrong Answer");
+        return;
+    }
+    q.push_back("x");
+    all.append(std::move(q));
+    stl.push_back("x");
+    if (!same(all, stl)) {
+        puts("Wrong Answer");
+        return;
+    }
+    puts("Accept");
+}
+
+int main() {
+    srand(time(NULL));
+    puts("test start:");
+    test1();  // insert ranges
+    test2();  // insert copies
+    test3();  // append & assign
+    test4();  // erase ranges
+    test5();  // split & splice
+}